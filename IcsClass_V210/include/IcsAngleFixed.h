@@ -0,0 +1,72 @@
+/**
+ *  @file IcsAngleFixed.h
+ * @brief Exact, divide-free conversion between servo positions and angles x100
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Angle_Fixed_h_
+#define _ics_Angle_Fixed_h_
+
+// IcsAngleFixed class ///////////////////////////////////////////////////
+/**
+ * @class IcsAngleFixed
+ * @brief Position <-> angle (deg x100) with a single ratio: 8000 position units are 270 deg, 27/8 deg x100 per unit
+ * @brief toDeg100() rounds to the nearest 0.01 deg, toPos() to the nearest position. toPos(toDeg100(pos)) == pos for
+ *        every position 3500-11500 (checked at compile time in IcsAngleFixed.cpp). Both are constexpr and use only a
+ *        multiply, an add and a shift.
+ * @note IcsBaseClass::degPos100()/posDeg100() use 2963/10000 one way and 1000/296 the other, so a round trip drifts by
+ *       up to 4 positions. degPos100() stays within one position of toPos(), posDeg100() reads up to 0.14 deg more
+ *       than toDeg100() at the ends of the range.
+ **/
+class IcsAngleFixed
+{
+  // Fixed value (published)
+public:
+  static constexpr int POS_MIN = 3500;       ///< Lowest servo position
+  static constexpr int POS_MAX = 11500;      ///< Highest servo position
+  static constexpr int POS_CENTER = 7500;    ///< Position at 0 deg
+  static constexpr int DEG100_MIN = -13500;  ///< Angle at POS_MIN (deg x100)
+  static constexpr int DEG100_MAX = 13500;   ///< Angle at POS_MAX (deg x100)
+  static constexpr int POS_FALSE = -1;       ///< toPos() result out of range
+  static constexpr int DEG100_FALSE = 0x7FFF; ///< toDeg100() result out of range (negative side: -DEG100_FALSE)
+
+  // Fixed value (undisclosed)
+protected:
+  static constexpr int RECIP_SHIFT = 22;                                          ///< Shift of the 1/27 multiplier
+  static constexpr unsigned long long RECIP_27 = ((1ULL << RECIP_SHIFT) + 26) / 27; ///< ceil(2^22 / 27), exact for n < 2^18
+
+  // Functions
+public:
+  /**
+   * @brief Convert position data to an angle
+   * @param[in] pos Position data
+   * @return Angle (deg x100)
+   * @retval #DEG100_FALSE Out of range in positive direction
+   * @retval -#DEG100_FALSE Out of range in negative direction
+   **/
+  static constexpr int toDeg100(int pos)
+  {
+    return (pos < POS_MIN) ? -DEG100_FALSE
+           : (pos > POS_MAX) ? DEG100_FALSE
+                             : (((pos - POS_MIN) * 27 + 4) >> 3) + DEG100_MIN;
+  }
+
+  /**
+   * @brief Convert an angle to position data
+   * @param[in] deg100 Angle (deg x100)
+   * @return Position data
+   * @retval #POS_FALSE Out of range
+   **/
+  static constexpr int toPos(int deg100)
+  {
+    return (deg100 < DEG100_MIN || deg100 > DEG100_MAX)
+               ? POS_FALSE
+               : POS_MIN + (int)(((unsigned long long)((deg100 - DEG100_MIN) * 8 + 13) * RECIP_27) >> RECIP_SHIFT);
+  }
+};
+
+#endif
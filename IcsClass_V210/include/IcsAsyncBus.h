@@ -0,0 +1,74 @@
+/**
+ *  @file IcsAsyncBus.h
+ * @brief Asynchronous submit/complete access to one ICS bus
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Async_Bus_h_
+#define _ics_Async_Bus_h_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "IcsCommand.h"
+
+/**
+ * @struct IcsCompletion
+ * @brief Result of a command submitted to an IcsAsyncBus
+ **/
+struct IcsCompletion
+{
+  unsigned long ticket = 0; ///< Handle returned by IcsAsyncBus::submit()
+  IcsCommand cmd;           ///< Command that was run
+  int result = IcsBaseClass::ICS_FALSE; ///< Return value of the IcsBaseClass call
+};
+
+// IcsAsyncBus class ///////////////////////////////////////////////////
+/**
+ * @class IcsAsyncBus
+ * @brief Runs the commands of one bus on a worker thread so the caller can keep computing
+ * @brief Commands are executed in submission order; results are collected from the completion queue
+ **/
+class IcsAsyncBus
+{
+  // Constructor, Destructor
+public:
+  IcsAsyncBus(IcsBaseClass &bus);
+  ~IcsAsyncBus();
+
+  IcsAsyncBus(const IcsAsyncBus &) = delete;
+  IcsAsyncBus &operator=(const IcsAsyncBus &) = delete;
+
+  // Variables
+protected:
+  IcsBaseClass &bus_default;                ///< Bus the commands are sent to
+  std::thread worker;                       ///< Thread running the commands
+  std::mutex lock;                          ///< Protects the queues and counters below
+  std::condition_variable submitted_cv;     ///< Signalled when a command is submitted or on shutdown
+  std::condition_variable completed_cv;     ///< Signalled when a command completes
+  std::deque<IcsCompletion> submit_queue;   ///< Commands waiting for the bus
+  std::deque<IcsCompletion> complete_queue; ///< Finished commands not collected yet
+  unsigned long next_ticket = 1;            ///< Handle given to the next submitted command
+  unsigned long in_flight = 0;              ///< Commands submitted but not completed
+  bool stopping = false;                    ///< Set by the destructor
+
+  // Functions
+public:
+  unsigned long submit(const IcsCommand &cmd);
+  bool poll(IcsCompletion &completion);
+  bool wait(IcsCompletion &completion, int timeout = -1);
+  bool waitIdle(int timeout = -1);
+  unsigned long pending();
+
+  IcsBaseClass &getBus();
+
+protected:
+  void run();
+};
+
+#endif
@@ -39,6 +39,8 @@
  **/
 class IcsBaseClass
 {
+  friend struct IcsCommand; // Shares the range checks when building raw frames
+
   // Fixed value (published)
 public:
   // Servo ID range //////////////////////////////////////
@@ -144,5 +146,10 @@ public:
   static int degPos100(int deg);
   // Angle conversion x100 Convert from angle to POS
   static int posDeg100(int pos);
+
+  // Angle conversion of whole joint arrays (NEON/AVX2/SSE2 where available, same results as degPos/posDeg)
+  static int degPosBatch(const float *deg, int *pos, int count, unsigned int *mask = nullptr);
+  static int posDegBatch(const int *pos, float *deg, int count, unsigned int *mask = nullptr);
+  static const char *batchKernel();
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+/**
+ *  @file IcsBusHub.h
+ * @brief Drives several ICS buses concurrently, one worker thread per bus
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Bus_Hub_h_
+#define _ics_Bus_Hub_h_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "IcsCommand.h"
+#include "IcsJointStateTable.h"
+#include "IcsRtPolicy.h"
+#include "IcsSpscRing.h"
+
+/**
+ * @struct IcsJoint
+ * @brief Location of one servo: bus index in the hub and servo ID on that bus
+ **/
+struct IcsJoint
+{
+  int bus = 0;          ///< Index returned by IcsBusHub::addBus()
+  unsigned char id = 0; ///< Servo ID on that bus
+};
+
+/**
+ * @struct IcsJointTarget
+ * @brief Position command handed from the control thread to a bus worker
+ **/
+struct IcsJointTarget
+{
+  unsigned char id = 0; ///< Servo ID on the bus
+  unsigned int pos = 0; ///< Target position
+};
+
+/**
+ * @struct IcsJointFeedback
+ * @brief Reply handed from a bus worker back to the control thread
+ **/
+struct IcsJointFeedback
+{
+  unsigned char id = 0;                ///< Servo ID on the bus
+  int pos = IcsBaseClass::ICS_FALSE;   ///< Position returned by setPos()
+  long long timestampNs = 0;           ///< CLOCK_MONOTONIC time the reply was received (ns)
+  bool ok = false;                     ///< false on communication failure
+};
+
+// IcsBusHub class ///////////////////////////////////////////////////
+/**
+ * @class IcsBusHub
+ * @brief Owns N buses and a joint table, and runs each bus on its own worker thread
+ * @brief A whole-robot call returns when the slowest bus is done instead of after the sum of all buses
+ * @brief Targets can also be streamed without locks through per-bus SPSC rings (pushTarget/commitTargets/popFeedback)
+ * @attention Add all buses and joints before the first whole-robot call.
+ **/
+class IcsBusHub
+{
+  // Constructor, Destructor
+public:
+  IcsBusHub();
+  ~IcsBusHub();
+
+  IcsBusHub(const IcsBusHub &) = delete;
+  IcsBusHub &operator=(const IcsBusHub &) = delete;
+
+  // Fixed value (published)
+public:
+  static constexpr size_t RING_SIZE = 64; ///< Capacity of the per-bus target and feedback rings
+
+  // Variables
+protected:
+  /**
+   * @struct BusWorker
+   * @brief One bus and the thread that talks to it
+   **/
+  struct BusWorker
+  {
+    IcsBaseClass *bus = nullptr;          ///< Bus driven by this worker
+    std::unique_ptr<IcsBaseClass> owned;  ///< Set when the hub created the bus
+    std::vector<int> joints;              ///< Joint indices living on this bus, in command order
+    std::thread thread;                   ///< Worker thread
+    unsigned long generation = 0;         ///< Last batch run by this worker
+    int wake_fd = -1;                     ///< eventfd the worker sleeps on
+    IcsSpscRing<IcsJointTarget, RING_SIZE> targets;    ///< Control thread -> worker
+    IcsSpscRing<IcsJointFeedback, RING_SIZE> feedback; ///< Worker -> control thread
+    std::atomic<unsigned long> feedback_dropped{0};    ///< Replies lost because the feedback ring was full
+    IcsRtPolicy rt_policy;                ///< Real-time settings to apply on the worker thread
+    IcsRtReport rt_report;                ///< What the last applied policy achieved
+    bool rt_pending = false;              ///< rt_policy waits to be applied by the worker
+    bool rt_check_only = false;           ///< The pending request only reads the settings back
+  };
+
+  std::vector<std::unique_ptr<BusWorker>> workers; ///< One entry per bus
+  std::vector<IcsJoint> joints;                    ///< Joint table
+  IcsJointStateTable state_table;                  ///< Last known state of every joint, for concurrent readers
+
+  std::mutex lock;                    ///< Protects the batch description below
+  std::condition_variable done_cv;    ///< Signalled when a worker finishes its part of a batch
+  unsigned long generation = 0;       ///< Incremented for every batch
+  int busy = 0;                       ///< Workers still running the current batch
+  bool stopping = false;              ///< Set by the destructor
+
+  IcsCommand::Type batch_type = IcsCommand::SET_POS; ///< Command of the current batch
+  const unsigned int *batch_values = nullptr;        ///< Per-joint values of the current batch (may be null)
+  int *batch_results = nullptr;                      ///< Per-joint results of the current batch
+  std::vector<long long> batch_times;                ///< Per-joint reply times of the current batch (ns)
+
+  // Functions
+public:
+  // Configuration
+  int addBus(IcsBaseClass &bus);
+  int addBus(const char *device, unsigned char enpin, unsigned int baudrate, int timeout);
+  int addJoint(int bus, unsigned char id);
+
+  int getBusCount() const;
+  int getJointCount() const;
+  IcsBaseClass &getBus(int bus);
+  const IcsJoint &getJoint(int joint) const;
+
+  // Whole robot, all buses in parallel
+  bool run(IcsCommand::Type type, const unsigned int *values, int *results);
+  bool setPositions(const unsigned int *pos, int *results);
+  bool readPositions(int *pos);
+
+  // Streaming, lock-free on the control thread side
+  bool pushTarget(int bus, unsigned char id, unsigned int pos);
+  void commitTargets();
+  bool popFeedback(int bus, IcsJointFeedback &feedback);
+  unsigned long getFeedbackDropped(int bus) const;
+
+  // Real-time settings of the worker threads
+  IcsRtReport setRtPolicy(int bus, const IcsRtPolicy &policy);
+  IcsRtReport checkRtPolicy(int bus);
+
+  // Published joint state
+  const IcsJointStateTable &getStateTable() const;
+
+protected:
+  void publish(IcsCommand::Type type, const int *results);
+  IcsRtReport runOnWorker(int bus, const IcsRtPolicy *policy);
+  void wake(BusWorker *worker);
+  int startWorker(BusWorker *worker);
+  void workerLoop(BusWorker *worker);
+};
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ *  @file IcsBusScan.h
+ * @brief Servo discovery: which IDs answer on which bus, probed on all buses at once
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Bus_Scan_h_
+#define _ics_Bus_Scan_h_
+
+#include <vector>
+#include "IcsBaseClass.h"
+
+class IcsBusHub;
+
+/**
+ * @struct IcsScanBus
+ * @brief What one bus answered. ID masks use bit id (IDs 0-31).
+ **/
+struct IcsScanBus
+{
+  std::vector<unsigned char> ids;  ///< IDs that answered, ascending
+  unsigned int present = 0;        ///< IDs that answered (at least one complete reply)
+  unsigned int duplicates = 0;     ///< IDs answered by more than one servo (extra bytes or two corrupted replies)
+  unsigned int partial = 0;        ///< IDs that sent an incomplete reply (wiring, baud rate or a slow servo)
+  int temperature[32];             ///< Temperature reply of each present ID, #ICS_FALSE otherwise
+  int probes = 0;                  ///< Commands sent, re-probes included
+  long long elapsedNs = 0;         ///< Time spent on this bus
+
+  IcsScanBus();
+};
+
+/**
+ * @struct IcsScanResult
+ * @brief Servo map of all buses, in bus index order
+ **/
+struct IcsScanResult
+{
+  std::vector<IcsScanBus> buses; ///< One entry per bus
+  long long elapsedNs = 0;       ///< Wall time of the whole scan
+
+  int getServoCount() const;
+  int getDuplicateCount() const;
+  int findBus(unsigned char id) const;
+};
+
+// IcsBusScan class ///////////////////////////////////////////////////
+/**
+ * @class IcsBusScan
+ * @brief Finds the servos on every bus by probing each ID with a temperature read, one thread per bus
+ * @brief Unlike IcsBaseClass::getID() it works with any number of servos per bus and needs no 500 ms wait: an absent
+ *        ID costs one command plus the probe timeout, so 32 IDs take a few tens of ms and all buses run side by side.
+ * @brief A servo that answers is present. Bytes following a complete reply, or a reply that does not match the command
+ *        twice in a row (once could be noise), mean two servos share that ID.
+ * @note The temperature read (SC 0x04) is used because ICS 3.5 servos answer it too, unlike the position read (SC 0x05).
+ * @note Two real servos with the same ID answer at the same moment and their bytes collide on the wire: the UART sees
+ *       one garbled reply, possibly with framing errors, or even a valid looking one when the replies are identical.
+ *       IcsServoSim sends duplicate replies one after the other, so a scan against it flags every shared ID, while
+ *       on a robot a shared ID may be missed. Check getServoCount() against the expected servo count as well.
+ * @attention The buses must be idle: do not scan while an IcsBusHub or IcsCycleDriver runs whole-robot calls.
+ **/
+class IcsBusScan
+{
+  // Constructor
+public:
+  IcsBusScan();
+
+  // Fixed value (published)
+public:
+  static constexpr int ID_COUNT = 32; ///< IDs 0-31
+
+  // Variables
+protected:
+  unsigned int probe_timeout_us = 1000;   ///< Wait for the reply after the command has left, on top of its wire time (us)
+  unsigned int duplicate_window_us = 100; ///< Extra wait for a second reply after a complete one (us)
+  unsigned int id_mask = 0xFFFFFFFF;      ///< IDs to probe, bit id
+
+  // Functions
+public:
+  void setProbeTimeout(unsigned int timeoutUs);
+  unsigned int getProbeTimeout() const;
+  void setDuplicateWindow(unsigned int windowUs);
+  unsigned int getDuplicateWindow() const;
+  void setIdMask(unsigned int mask);
+  unsigned int getIdMask() const;
+
+  // Scans
+  bool scan(IcsBusHub &hub, IcsScanResult &result) const;
+  bool scan(const std::vector<IcsBaseClass *> &buses, IcsScanResult &result) const;
+  void scanBus(IcsBaseClass &bus, IcsScanBus &result) const;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ *  @file IcsCalibration.h
+ * @brief Per-joint calibration between joint angles (rad) and servo positions
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Calibration_h_
+#define _ics_Calibration_h_
+
+#include <vector>
+
+/**
+ * @struct IcsJointCalibration
+ * @brief Calibration of one joint: servo angle = sign * gear * joint angle + offset
+ **/
+struct IcsJointCalibration
+{
+  float offset = 0.0f;     ///< Servo angle at joint angle 0 (rad)
+  int sign = 1;            ///< +1, or -1 when the servo turns against the joint
+  float gear = 1.0f;       ///< Servo turns per joint turn
+  float minRad = -2.356f;  ///< Lower soft limit of the joint angle (rad), default -135 deg
+  float maxRad = 2.356f;   ///< Upper soft limit of the joint angle (rad), default 135 deg
+};
+
+// IcsCalibration class ///////////////////////////////////////////////////
+/**
+ * @class IcsCalibration
+ * @brief Calibration table of the whole robot, and the mapping stage between joint angle arrays and position arrays
+ * @brief Joint j is the joint j of IcsBusHub (same order as addJoint()), so the positions go straight to
+ *        setPositions(). The table is kept as one array per coefficient, so a mapping pass is a few multiply-adds and
+ *        compares per joint that the compiler vectorises.
+ * @note 8000 position units are 270 deg, the ratio of IcsAngleFixed.
+ **/
+class IcsCalibration
+{
+  // Constructor
+public:
+  IcsCalibration(int joints = 0);
+
+  // Fixed value (published)
+public:
+  static constexpr float POS_PER_RAD = 8000.0f / 4.71238898f; ///< Position units per servo radian (8000 per 270 deg)
+
+  // Variables
+protected:
+  std::vector<IcsJointCalibration> joints_default; ///< Calibration as given
+
+  // Derived per joint, pos = scale * rad + center, clamped to [low, high]
+  std::vector<float> scale;     ///< Position units per joint radian (signed)
+  std::vector<float> inv_scale; ///< Joint radians per position unit (signed)
+  std::vector<float> center;    ///< Position at joint angle 0
+  std::vector<float> low;       ///< Lowest allowed position (soft limit and servo range)
+  std::vector<float> high;      ///< Highest allowed position (soft limit and servo range)
+
+  // Functions
+public:
+  void resize(int joints);
+  int getJointCount() const;
+  bool setJoint(int joint, const IcsJointCalibration &calibration);
+  const IcsJointCalibration &getJoint(int joint) const;
+  bool mirror(int joint, int from, float offset = 0.0f);
+  bool load(const char *path);
+
+  // Mapping stage
+  int toPositions(const float *rad, unsigned int *pos, unsigned int *mask = nullptr) const;
+  int toRadians(const int *pos, float *rad, unsigned int *mask = nullptr) const;
+
+protected:
+  void derive(int joint);
+};
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ *  @file IcsClock.h
+ * @brief 64-bit CLOCK_MONOTONIC nanosecond time used for all bus timing
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Clock_h_
+#define _ics_Clock_h_
+
+#include <time.h>
+
+// IcsClock class ///////////////////////////////////////////////////
+/**
+ * @class IcsClock
+ * @brief Monotonic time in signed 64-bit nanoseconds
+ * @brief Unlike wiringPi's 32-bit micros() it does not wrap (about 292 years), is unaffected by wall clock changes,
+ *        and deadlines can be stored as absolute times and compared directly.
+ **/
+class IcsClock
+{
+public:
+  static constexpr long long NS_PER_US = 1000LL;       ///< Nanoseconds per microsecond
+  static constexpr long long NS_PER_MS = 1000000LL;    ///< Nanoseconds per millisecond
+  static constexpr long long NS_PER_S = 1000000000LL;  ///< Nanoseconds per second
+
+  /**
+   * @brief Current CLOCK_MONOTONIC time
+   * @return Time (ns)
+   **/
+  static long long nowNs()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+  }
+
+  /**
+   * @brief Absolute deadline a given time from now
+   * @param[in] fromNowNs Relative time (ns)
+   * @return Absolute CLOCK_MONOTONIC time (ns)
+   **/
+  static long long deadlineNs(long long fromNowNs)
+  {
+    return nowNs() + fromNowNs;
+  }
+
+  /**
+   * @brief Convert a duration to a timespec (negative durations become zero)
+   * @param[in] ns Duration or absolute time (ns)
+   * @return timespec for ppoll/clock_nanosleep
+   **/
+  static struct timespec toTimespec(long long ns)
+  {
+    struct timespec ts;
+    if (ns < 0)
+      ns = 0;
+    ts.tv_sec = ns / NS_PER_S;
+    ts.tv_nsec = ns % NS_PER_S;
+    return ts;
+  }
+};
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ *  @file IcsCommand.h
+ * @brief Servo command description shared by the asynchronous bus layers
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Command_h_
+#define _ics_Command_h_
+
+#include "IcsBaseClass.h"
+
+/**
+ * @struct IcsCommand
+ * @brief One IcsBaseClass call captured as data so it can be queued and run later
+ **/
+struct IcsCommand
+{
+  /**
+   * @enum Type
+   * @brief IcsBaseClass function to call
+   **/
+  enum Type
+  {
+    SET_POS = 0, ///< setPos(id, value)
+    SET_FREE,    ///< setFree(id)
+    SET_STRC,    ///< setStrc(id, value)
+    SET_SPD,     ///< setSpd(id, value)
+    SET_CUR,     ///< setCur(id, value)
+    SET_TMP,     ///< setTmp(id, value)
+    GET_STRC,    ///< getStrc(id)
+    GET_SPD,     ///< getSpd(id)
+    GET_CUR,     ///< getCur(id)
+    GET_TMP,     ///< getTmp(id)
+    GET_POS,     ///< getPos(id)
+    GET_ID       ///< getID(), id is ignored (only one servo on the bus)
+  };
+
+  Type type = SET_POS;    ///< Function to call
+  unsigned char id = 0;   ///< Servo ID
+  unsigned int value = 0; ///< Position or parameter value (ignored by getters and SET_FREE)
+
+  IcsCommand() {}
+  IcsCommand(Type t, unsigned char i, unsigned int v = 0) : type(t), id(i), value(v) {}
+
+  int execute(IcsBaseClass &bus) const;
+
+  // Raw frames, for engines that drive the UART themselves
+  static constexpr int MAX_TX_LEN = 4; ///< Longest command frame built by encode()
+  static constexpr int MAX_RX_LEN = 4; ///< Longest reply frame expected by encode()
+
+  bool encode(unsigned char *txBuf, unsigned char &txLen, unsigned char &rxLen) const;
+  int decode(const unsigned char *rxBuf) const;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ *  @file IcsCycleDriver.h
+ * @brief Fixed-period control loop on top of IcsBusHub with deadline-miss accounting
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Cycle_Driver_h_
+#define _ics_Cycle_Driver_h_
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "IcsBusHub.h"
+
+/**
+ * @struct IcsCycleStats
+ * @brief Timing of the cycles run so far (all times in ns)
+ **/
+struct IcsCycleStats
+{
+  unsigned long cycles = 0;       ///< Cycles run
+  unsigned long misses = 0;       ///< Cycles that ended after the start of the next period
+  unsigned long skipped = 0;      ///< Periods dropped to catch up after misses
+  long long jitterMinNs = 0;      ///< Smallest wake-up delay after the scheduled start
+  long long jitterMaxNs = 0;      ///< Largest wake-up delay after the scheduled start
+  long long jitterSumNs = 0;      ///< Sum of wake-up delays (divide by cycles for the mean)
+  long long execMinNs = 0;        ///< Shortest cycle (callback + bus traffic)
+  long long execMaxNs = 0;        ///< Longest cycle
+  long long execSumNs = 0;        ///< Sum of cycle times (divide by cycles for the mean)
+};
+
+// IcsCycleDriver class ///////////////////////////////////////////////////
+/**
+ * @class IcsCycleDriver
+ * @brief Runs a user callback every period on an absolute CLOCK_MONOTONIC schedule and sends its targets to all buses
+ * @brief Each cycle: sleep until the period start, call the callback with the previous cycle's position replies,
+ *        send the targets it wrote with IcsBusHub::setPositions(), record jitter, execution time and misses.
+ **/
+class IcsCycleDriver
+{
+  // Type definitions within the class
+public:
+  /**
+   * @brief Control law called once per cycle
+   * @param cycle Cycle number, starting at 0
+   * @param feedback Per-joint positions returned in the previous cycle (#ICS_FALSE on failure)
+   * @param targets Per-joint target positions to send, pre-filled with the previous targets
+   * @param joints Number of joints
+   **/
+  typedef std::function<void(unsigned long cycle, const int *feedback, unsigned int *targets, int joints)> Callback;
+
+  // Constructor
+public:
+  IcsCycleDriver(IcsBusHub &hub, long long periodNs);
+
+  // Variables
+protected:
+  IcsBusHub &hub_default;                ///< Buses the targets are sent to
+  long long period_default;              ///< Cycle period (ns)
+  Callback callback_default;             ///< Control law
+  std::vector<int> feedback;             ///< Replies of the previous cycle
+  std::vector<unsigned int> targets;     ///< Targets of the current cycle
+  IcsCycleStats stats_default;           ///< Timing statistics
+  std::atomic<bool> stop_requested{false}; ///< Set by stop()
+
+  // Functions
+public:
+  void setCallback(Callback callback);
+  long long getPeriodNs() const;
+
+  bool run(unsigned long cycles = 0);
+  void stop();
+
+  const IcsCycleStats &getStats() const;
+  void resetStats();
+
+protected:
+  void record(long long jitterNs, long long execNs);
+};
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ *  @file IcsDiag.h
+ * @brief Structured diagnostic events of the bus hot path and their background consumer
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Diag_h_
+#define _ics_Diag_h_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "IcsSpscRing.h"
+
+/**
+ * @struct IcsDiagEvent
+ * @brief One thing that went wrong on a bus, recorded as plain data so the hot path never formats text
+ **/
+struct IcsDiagEvent
+{
+  /**
+   * @enum Code
+   * @brief What happened
+   **/
+  enum Code
+  {
+    DIAG_WRITE_FAILED = 0,    ///< The command could not be written completely
+    DIAG_READ_FAILED = 1,     ///< read() on the port failed (see err)
+    DIAG_TIMEOUT = 2,         ///< Not a single reply byte arrived
+    DIAG_SHORT_REPLY = 3,     ///< The reply stopped before rxLen bytes
+    DIAG_HEADER_MISMATCH = 4, ///< Complete reply that does not answer the command
+    DIAG_STALE_BYTES = 5      ///< Bytes of an old reply discarded while resynchronising
+  };
+
+  Code code;                ///< Event code
+  unsigned char bus;        ///< Bus number set with IcsHardSerialClass::setBusId()
+  unsigned char id;         ///< Servo ID (lower 5 bits of the command byte)
+  unsigned char cmd;        ///< Command type (upper 3 bits of the command byte)
+  unsigned char expected;   ///< Bytes expected (sent for writes, reply length for reads)
+  int received;             ///< Bytes actually transferred
+  int err;                  ///< errno of the failing system call, 0 if none
+  long long timestampNs;    ///< IcsClock::nowNs() when the event was recorded
+};
+
+/**
+ * @brief Per-bus event ring, written by whichever thread drives the bus
+ **/
+typedef IcsSpscRing<IcsDiagEvent, 128> IcsDiagRing;
+
+class IcsHardSerialClass;
+
+// IcsDiagLogger class ///////////////////////////////////////////////////
+/**
+ * @class IcsDiagLogger
+ * @brief Drains the diagnostic rings of several buses away from the control threads
+ * @brief By default the events are printed to stderr. A sink can be installed to forward them elsewhere.
+ * @attention Exactly one logger may drain a given bus.
+ **/
+class IcsDiagLogger
+{
+  // Type definitions within the class
+public:
+  typedef std::function<void(const IcsDiagEvent &event)> Sink; ///< Receives every drained event
+
+  // Constructor, Destructor
+public:
+  // Constructor
+  IcsDiagLogger();
+
+  // Descructor
+  ~IcsDiagLogger();
+
+  // Variables
+protected:
+  std::vector<IcsHardSerialClass *> buses;  ///< Buses whose rings are drained
+  Sink sink;                                ///< Event consumer (empty: print to stderr)
+  std::thread thread;                       ///< Background consumer
+  std::mutex lock;                          ///< Protects stopping
+  std::condition_variable stop_cv;          ///< Wakes the consumer early on stop()
+  bool stopping = false;                    ///< Request to leave the consumer loop
+  unsigned long reported_dropped = 0;       ///< Dropped events already reported
+
+  // Functions
+public:
+  void addBus(IcsHardSerialClass &bus);
+  void setSink(const Sink &eventSink);
+  int drain();
+  void start(unsigned int periodMs = 100);
+  void stop();
+
+  static const char *codeName(IcsDiagEvent::Code code);
+  static void print(const IcsDiagEvent &event);
+
+protected:
+  void consumerLoop(unsigned int periodMs);
+};
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ *  @file IcsEpollEngine.h
+ * @brief Drives several ICS buses from a single thread with epoll
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Epoll_Engine_h_
+#define _ics_Epoll_Engine_h_
+
+#include <vector>
+#include "IcsBusHub.h"
+#include "IcsHardSerialClass.h"
+
+// IcsEpollEngine class ///////////////////////////////////////////////////
+/**
+ * @class IcsEpollEngine
+ * @brief Single-thread alternative to IcsBusHub for rigs with many buses
+ * @brief Sends a command on every bus, then harvests whichever reply arrives first and immediately starts the
+ *        next command on that bus. One core keeps every bus busy without per-bus threads.
+ * @attention Add all buses and joints before the first whole-robot call.
+ **/
+class IcsEpollEngine
+{
+  // Constructor, Destructor
+public:
+  IcsEpollEngine();
+  ~IcsEpollEngine();
+
+  IcsEpollEngine(const IcsEpollEngine &) = delete;
+  IcsEpollEngine &operator=(const IcsEpollEngine &) = delete;
+
+  // Variables
+protected:
+  /**
+   * @struct BusState
+   * @brief Transaction in progress on one bus
+   **/
+  struct BusState
+  {
+    IcsHardSerialClass *bus = nullptr;              ///< Bus driven by this slot
+    std::vector<int> joints;                        ///< Joint indices living on this bus, in command order
+    size_t next = 0;                                ///< Next entry of joints to send
+    bool active = false;                            ///< A reply is being waited for
+    int joint = -1;                                 ///< Joint of the transaction in progress
+    IcsCommand cmd;                                 ///< Command of the transaction in progress
+    unsigned char tx[IcsCommand::MAX_TX_LEN] = {};  ///< Command frame
+    unsigned char rx[IcsCommand::MAX_RX_LEN] = {};  ///< Reply collected so far
+    unsigned char txLen = 0;                        ///< Command length
+    unsigned char rxLen = 0;                        ///< Expected reply length
+    int bytesRead = 0;                              ///< Reply bytes received so far
+    long long frameDeadlineNs = 0;                  ///< CLOCK_MONOTONIC time by which the reply must be complete
+    long long deadlineNs = 0;                       ///< Frame deadline, tightened to the inter-byte deadline once bytes arrive
+  };
+
+  int epoll_fd = -1;              ///< epoll instance watching every bus
+  std::vector<BusState> buses;    ///< One entry per bus
+  std::vector<IcsJoint> joints;   ///< Joint table
+
+  // Functions
+public:
+  // Configuration
+  int addBus(IcsHardSerialClass &bus);
+  int addJoint(int bus, unsigned char id);
+
+  int getBusCount() const;
+  int getJointCount() const;
+  const IcsJoint &getJoint(int joint) const;
+
+  // Whole robot, all buses interleaved
+  bool run(IcsCommand::Type type, const unsigned int *values, int *results);
+  bool setPositions(const unsigned int *pos, int *results);
+  bool readPositions(int *pos);
+
+protected:
+  bool startNext(BusState &state, IcsCommand::Type type, const unsigned int *values, int *results);
+  void complete(BusState &state, int *results);
+};
+
+#endif
@@ -13,12 +13,36 @@
 #define _ics_HardSerial_Servo_h_
 
 #include "IcsBaseClass.h"
+#include "IcsClock.h"
+#include "IcsDiag.h"
+#include "IcsLatency.h"
+#include <memory>
+#include "IcsTimingModel.h"
 #include <asm/termbits.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 #include <wiringPi.h>
 
+/**
+ * @struct IcsBusStats
+ * @brief Transaction and stream resynchronisation counters of one bus
+ **/
+struct IcsBusStats
+{
+  unsigned long transactions = 0;    ///< Number of synchronize() calls
+  unsigned long failures = 0;        ///< Transactions that returned false
+  unsigned long shortReplies = 0;    ///< Replies with fewer bytes than expected (including timeouts)
+  unsigned long headerErrors = 0;    ///< Complete replies whose header did not match the command
+  unsigned long parityErrors = 0;    ///< Parity errors reported by the UART driver
+  unsigned long frameErrors = 0;     ///< Framing errors reported by the UART driver
+  unsigned long overruns = 0;        ///< UART and tty buffer overruns reported by the driver
+  unsigned long resyncs = 0;         ///< Number of receive buffer flushes
+  unsigned long staleBytes = 0;      ///< Bytes discarded while resynchronising or received as a reply to another command
+  unsigned long lateReplies = 0;     ///< Timed out transactions whose reply showed up afterwards
+};
+
 // IcsHardSerialClass class ///////////////////////////////////////////////////
 /**
  * @class IcsHardSerialClass
@@ -29,6 +53,33 @@ class IcsHardSerialClass : public IcsBaseClass
 {
   // Type definitions within the class
 public:
+  /**
+   * @enum RxMode
+   * @brief How synchronize() waits for the servo reply
+   **/
+  enum RxMode
+  {
+    RX_MODE_SPIN = 0, ///< Busy-wait on FIONREAD with short sleeps (original behaviour)
+    RX_MODE_POLL = 1  ///< Block in the kernel with ppoll() on the file descriptor until data arrives
+  };
+
+  /**
+   * @enum DirMode
+   * @brief Who switches the half-duplex buffer between sending and receiving
+   **/
+  enum DirMode
+  {
+    DIR_MODE_GPIO = 0, ///< synchronize() drives the enable pin through wiringPi, released when the transmitter has drained (IcsTimingModel)
+    DIR_MODE_RS485 = 1 ///< The UART driver drives RTS itself (TIOCSRS485), released right after the last stop bit
+  };
+
+  // Fixed value (published)
+public:
+  static const int SERIAL_PINS[10]; ///< UART0-4 Tx Rx pins, BCM numbering
+  static const int ENABLE_PINS[5];  ///< Enable pins of UART0-4 based on Venky's PCB, BCM numbering
+
+  static int defaultEnablePin(const char *device);
+
   // Constructor, Destructor
 public:
   // Constructor
@@ -44,10 +95,30 @@ protected:
   int enpin_default = 18;                                      ///< Variable to store the pin number of the enable pin (for switching between send and receive)
   unsigned int baudrate_default = 115200;                      ///< Variable to store the communication speed of ICS
   unsigned int timeout_default = 100;                          ///< Variable to store the communication timeout (ms)
+  long long timeout_ns = 100 * IcsClock::NS_PER_MS;            ///< Communication timeout in ns, used for the deadlines
+  long long interbyte_timeout_ns = 200 * IcsClock::NS_PER_US;  ///< Maximum gap between reply bytes (ns)
+  RxMode rxmode_default = RX_MODE_SPIN;                        ///< Variable to store the reply wait strategy
+  DirMode dirmode_default = DIR_MODE_GPIO;                     ///< Variable to store the direction control strategy
+  struct serial_rs485 rs485_backup;                            ///< RS-485 settings of the port before setRs485Mode()
+  bool rs485_backup_valid = false;                             ///< True when rs485_backup must be restored on close
+  IcsTimingModel timing_default;                               ///< Wire timing derived from baudrate_default
+  int lsr_support = -1;                                        ///< TIOCSERGETLSR support of the driver (-1 unknown, 0 no, 1 yes)
+  IcsBusStats stats_default;                                   ///< Transaction counters
+  bool resync_pending = false;                                 ///< True when the receive stream may hold bytes of an old reply
+  bool resync_after_timeout = false;                           ///< True while the reply of a timed out transaction may still show up
+  struct serial_icounter_struct icount_last;                   ///< Driver error counters at the last resync
+  bool icount_valid = false;                                   ///< True when the driver reports error counters (TIOCGICOUNT)
+  unsigned char bus_id_default = 0;                            ///< Bus number stamped on diagnostic events
+  unsigned char tx_cmd_default = 0;                            ///< Command byte of the transaction in progress
+  IcsDiagRing diag_ring;                                       ///< Diagnostic events waiting for an IcsDiagLogger
+  std::atomic<unsigned long> diag_dropped{0};                  ///< Events lost because the ring was full
+  std::unique_ptr<IcsBusLatency> latency_default;              ///< Latency histograms (on the heap, they are large)
+  bool latency_enabled = true;                                 ///< Record latencies in finishTransaction()
+  long long tx_start_ns = 0;                                   ///< Start of the transaction in progress
+  long long tx_done_ns = 0;                                    ///< Time the command had left the UART
+  long long rx_first_ns = 0;                                   ///< Time the first reply byte was read
   struct termios2 opt;                                         ///< Serial port settings
   struct termios2 opt_backup;                                  ///< Backup of current serial port settings
-  int serialPinsList[10] = {14, 15, 0, 1, 4, 5, 8, 9, 12, 13}; // UART0-4 Tx Rx pins BCM numbering
-  int enPinsList[5] = {18, 7, 6, 25, 19};                      // Enable pins based on Venky's PCB. BCM numbering.
 
   // Functions
 
@@ -55,6 +126,100 @@ protected:
 public:
   virtual bool synchronize(unsigned char *txBuf, unsigned char txLen, unsigned char *rxBuf, unsigned char rxLen);
 
+  // Split transaction, for event loops that wait on several ports at once
+public:
+  bool beginTransaction(const unsigned char *txBuf, unsigned char txLen, unsigned char rxLen);
+  int readAvailable(unsigned char *rxBuf, unsigned char rxLen, int bytesRead);
+  bool finishTransaction(const unsigned char *txBuf, unsigned char txLen, const unsigned char *rxBuf, unsigned char rxLen, int bytesRead);
+  int getFd() const;
+
+  // Timeouts
+public:
+  void setTimeout(unsigned int timeout);
+  unsigned int getTimeout() const;
+  long long getTimeoutNs() const;
+
+  // Receive mode selection
+public:
+  void setRxMode(RxMode mode);
+  RxMode getRxMode() const;
+
+  // Direction control
+public:
+  bool setRs485Mode(bool rtsOnSend = true, unsigned int delayRtsBeforeSend = 0, unsigned int delayRtsAfterSend = 0);
+  void setGpioMode();
+  DirMode getDirMode() const;
+
+  // Statistics and stream resynchronisation
+public:
+  const IcsBusStats &getStats() const;
+  void resetStats();
+  void resync();
+
+protected:
+  static bool checkReply(const unsigned char *txBuf, unsigned char txLen, const unsigned char *rxBuf);
+
+  // Timing
+public:
+  const IcsTimingModel &getTimingModel() const;
+
+protected:
+  void waitTxDrained(const IcsTransactionTiming &timing);
+
+  // Reply framing
+public:
+  void setInterByteTimeout(unsigned int timeout);
+  unsigned int getInterByteTimeout() const;
+  long long getInterByteTimeoutNs() const;
+
+protected:
+  bool waitForReply(long long deadlineNs);
+  int readFrame(unsigned char *rxBuf, unsigned char rxLen, long long deadlineNs);
+
+  // Latency instrumentation
+public:
+  IcsBusLatency &getLatency();
+  void setLatencyEnabled(bool enabled);
+  bool getLatencyEnabled() const;
+
+  // Diagnostics
+public:
+  void setBusId(unsigned char busId);
+  unsigned char getBusId() const;
+  IcsDiagRing &getDiagRing();
+  unsigned long getDiagDropped() const;
+
+protected:
+  /**
+   * @brief Record a diagnostic event without formatting or allocating
+   * @param[in] code Event code
+   * @param[in] expected Bytes expected
+   * @param[in] received Bytes actually transferred
+   * @param[in] err errno of the failing call, 0 if none
+   * @note Compiled out entirely when ICS_DIAG_DISABLE is defined.
+   **/
+  void recordDiag(IcsDiagEvent::Code code, unsigned char expected, int received, int err = 0)
+  {
+#ifndef ICS_DIAG_DISABLE
+    IcsDiagEvent event;
+    event.code = code;
+    event.bus = bus_id_default;
+    event.id = tx_cmd_default & 0x1F;
+    event.cmd = tx_cmd_default & 0xE0;
+    event.expected = expected;
+    event.received = received;
+    event.err = err;
+    event.timestampNs = IcsClock::nowNs();
+    if (!diag_ring.push(event))
+      diag_dropped.fetch_add(1, std::memory_order_relaxed);
+#else
+    (void)code;
+    (void)expected;
+    (void)received;
+    (void)err;
+#endif
+  }
+
   // Servo Related // All together
 public:
 };
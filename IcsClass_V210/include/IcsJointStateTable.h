@@ -0,0 +1,84 @@
+/**
+ *  @file IcsJointStateTable.h
+ * @brief Seqlock-published snapshot of the last known state of every joint
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Joint_State_Table_h_
+#define _ics_Joint_State_Table_h_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "IcsBaseClass.h"
+
+/**
+ * @struct IcsJointState
+ * @brief Last known state of one joint (#ICS_FALSE until the first successful reply)
+ **/
+struct IcsJointState
+{
+  int pos = IcsBaseClass::ICS_FALSE;         ///< Last position reply
+  int current = IcsBaseClass::ICS_FALSE;     ///< Last current reply (getCur)
+  int temperature = IcsBaseClass::ICS_FALSE; ///< Last temperature reply (getTmp)
+  long long timestampNs = 0;                 ///< CLOCK_MONOTONIC time of the newest of the values above (ns)
+};
+
+// IcsJointStateTable class ///////////////////////////////////////////////////
+/**
+ * @class IcsJointStateTable
+ * @brief Versioned joint state shared between the bus layer and any number of readers (logging, UI, safety monitor)
+ * @brief Writers group their updates between beginWrite() and endWrite(); readers copy the whole table with read()
+ *        and retry if a write overlapped, so they never block the writer and never see a half-updated robot.
+ * @attention Size the table (resize) before readers start.
+ **/
+class IcsJointStateTable
+{
+  // Constructor
+public:
+  IcsJointStateTable(int joints = 0);
+
+  IcsJointStateTable(const IcsJointStateTable &) = delete;
+  IcsJointStateTable &operator=(const IcsJointStateTable &) = delete;
+
+  // Variables
+protected:
+  /**
+   * @struct Slot
+   * @brief Storage of one joint. Fields are atomics so an overlapping read is retried rather than undefined.
+   **/
+  struct Slot
+  {
+    std::atomic<int> pos{IcsBaseClass::ICS_FALSE};
+    std::atomic<int> current{IcsBaseClass::ICS_FALSE};
+    std::atomic<int> temperature{IcsBaseClass::ICS_FALSE};
+    std::atomic<long long> timestampNs{0};
+  };
+
+  std::unique_ptr<Slot[]> slots;       ///< One slot per joint
+  int count = 0;                       ///< Number of joints
+  std::atomic<unsigned long> seq{0};   ///< Odd while a write is in progress
+  std::mutex write_lock;               ///< Serialises writers only, readers never take it
+
+  // Functions
+public:
+  void resize(int joints);
+  int size() const;
+
+  // Writer side
+  void beginWrite();
+  void setPos(int joint, int pos, long long timestampNs);
+  void setCurrent(int joint, int current, long long timestampNs);
+  void setTemperature(int joint, int temperature, long long timestampNs);
+  void endWrite();
+
+  // Reader side
+  unsigned long read(IcsJointState *states, int joints) const;
+  unsigned long getVersion() const;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ *  @file IcsLatency.h
+ * @brief Lock-free log-linear latency histograms of the bus transactions
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Latency_h_
+#define _ics_Latency_h_
+
+#include <atomic>
+
+/**
+ * @struct IcsLatencySnapshot
+ * @brief Plain copy of a histogram, taken without stopping the bus
+ **/
+struct IcsLatencySnapshot
+{
+  static constexpr int SUB_BITS = 4;                                  ///< log2 of the buckets per power of two
+  static constexpr int SUB_COUNT = 1 << SUB_BITS;                     ///< Buckets per power of two (resolution 1/16)
+  static constexpr int MAX_BITS = 32;                                 ///< Values from 2^32 ns (about 4.3 s) share the last bucket
+  static constexpr int BUCKETS = SUB_COUNT * (MAX_BITS - SUB_BITS + 1); ///< Number of buckets
+
+  unsigned int counts[BUCKETS]; ///< Samples per bucket
+  unsigned long long count;     ///< Total number of samples
+  long long sumNs;              ///< Sum of all samples (ns)
+  long long minNs;              ///< Smallest sample (ns), 0 without samples
+  long long maxNs;              ///< Largest sample (ns), 0 without samples
+
+  long long percentile(double p) const;
+  double meanNs() const;
+  void merge(const IcsLatencySnapshot &other);
+
+  static int bucketIndex(long long ns);
+  static long long bucketLow(int index);
+  static long long bucketHigh(int index);
+};
+
+// IcsLatencyHistogram class ///////////////////////////////////////////////////
+/**
+ * @class IcsLatencyHistogram
+ * @brief HDR-style histogram: exact below 16 ns, then 16 linear buckets per power of two (6.25 % resolution)
+ * @brief record() is wait-free for its single writer, snapshot() may be called from any thread at the same time.
+ * @attention Only one thread may record into a histogram.
+ **/
+class IcsLatencyHistogram
+{
+  // Constructor
+public:
+  IcsLatencyHistogram();
+
+  // Variables
+protected:
+  std::atomic<unsigned int> counts[IcsLatencySnapshot::BUCKETS]; ///< Samples per bucket
+  std::atomic<unsigned long long> count;                         ///< Total number of samples
+  std::atomic<long long> sum_ns;                                 ///< Sum of all samples (ns)
+  std::atomic<long long> min_ns;                                 ///< Smallest sample (ns)
+  std::atomic<long long> max_ns;                                 ///< Largest sample (ns)
+
+  // Functions
+public:
+  void record(long long ns);
+  void reset();
+  void snapshot(IcsLatencySnapshot &out) const;
+};
+
+/**
+ * @struct IcsLatencyCounters
+ * @brief Failure counters kept next to the histograms
+ **/
+struct IcsLatencyCounters
+{
+  unsigned long transactions; ///< Completed transactions (good or bad)
+  unsigned long timeouts;     ///< No reply byte at all
+  unsigned long shortReads;   ///< Reply started but stopped early
+  unsigned long overruns;     ///< UART overruns reported by the driver (bus scope only)
+};
+
+// IcsBusLatency class ///////////////////////////////////////////////////
+/**
+ * @class IcsBusLatency
+ * @brief Latency histograms and counters of one bus, per bus, per servo ID and per command type
+ **/
+class IcsBusLatency
+{
+  // Fixed value (published)
+public:
+  /**
+   * @enum Metric
+   * @brief Measured part of a transaction
+   **/
+  enum Metric
+  {
+    LAT_TOTAL = 0,      ///< Start of the command to the end of the reply
+    LAT_TX_DRAIN = 1,   ///< Start of the command until it has left the UART (RS-485 mode: until write() returned)
+    LAT_TURNAROUND = 2, ///< End of the command to the first reply byte
+    LAT_FIRST_BYTE = 3, ///< Start of the command to the first reply byte
+    LAT_METRICS = 4     ///< Number of metrics
+  };
+
+  static constexpr int SCOPE_BUS = 0;                 ///< Scope of all transactions of the bus
+  static constexpr int SCOPE_ID = 1;                  ///< First per-servo scope (SCOPE_ID + id)
+  static constexpr int ID_COUNT = 32;                 ///< Number of servo IDs
+  static constexpr int SCOPE_CMD = SCOPE_ID + ID_COUNT; ///< First per-command scope (SCOPE_CMD + type)
+  static constexpr int CMD_COUNT = 4;                 ///< Position (0x80), read (0xA0), write (0xC0), ID (0xFF/0xE0)
+  static constexpr int SCOPES = SCOPE_CMD + CMD_COUNT; ///< Number of scopes
+
+  // Variables
+protected:
+  IcsLatencyHistogram histograms[SCOPES][LAT_METRICS]; ///< Histograms per scope and metric
+  std::atomic<unsigned long> transactions[SCOPES];     ///< Transactions per scope
+  std::atomic<unsigned long> timeouts[SCOPES];         ///< Timeouts per scope
+  std::atomic<unsigned long> short_reads[SCOPES];      ///< Short replies per scope
+  std::atomic<unsigned long> overruns;                 ///< Driver overruns of the bus
+
+  // Functions
+public:
+  IcsBusLatency();
+
+  static int scopeOfId(unsigned char id);
+  static int scopeOfCmd(unsigned char cmd);
+
+  void record(unsigned char cmd, int rxLen, int bytesRead, long long startNs, long long txDoneNs, long long firstByteNs, long long endNs);
+  void addOverruns(unsigned long n);
+
+  void snapshot(int scope, Metric metric, IcsLatencySnapshot &out) const;
+  IcsLatencyCounters getCounters(int scope) const;
+  void reset();
+
+protected:
+  void recordScope(int scope, bool complete, bool started, long long total, long long txDrain, long long turnaround, long long firstByte);
+};
+
+#endif
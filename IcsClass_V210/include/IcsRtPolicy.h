@@ -0,0 +1,78 @@
+/**
+ *  @file IcsRtPolicy.h
+ * @brief Real-time scheduling, memory locking and CPU affinity for bus and control threads
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Rt_Policy_h_
+#define _ics_Rt_Policy_h_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @struct IcsRtReport
+ * @brief What an IcsRtPolicy actually achieved on a thread
+ * @brief Each *Ok flag is read back from the kernel after applying, not taken from the return code alone.
+ **/
+struct IcsRtReport
+{
+  bool schedulerOk = true;    ///< Scheduling class and priority in effect as requested
+  bool affinityOk = true;     ///< CPU mask in effect as requested
+  bool memoryLockOk = true;   ///< All current and future pages locked (mlockall succeeded and a new page comes locked)
+  bool stackOk = true;        ///< prefaultStackBytes of stack resident below the caller (mincore)
+  bool timerSlackOk = true;   ///< Timer slack in effect as requested
+  int schedulerErrno = 0;     ///< errno of the failed scheduler call (EPERM: missing CAP_SYS_NICE or RLIMIT_RTPRIO)
+  int affinityErrno = 0;      ///< errno of the failed affinity call (EINVAL: CPU offline or past CPU_SETSIZE)
+  int memoryLockErrno = 0;    ///< errno of the failed mlockall (EPERM/ENOMEM: RLIMIT_MEMLOCK)
+  int timerSlackErrno = 0;    ///< errno of the failed prctl
+
+  bool ok() const;
+  std::string summary() const;
+};
+
+// IcsRtPolicy class ///////////////////////////////////////////////////
+/**
+ * @class IcsRtPolicy
+ * @brief Real-time settings applied to the calling thread (and, for memory locking, to the whole process)
+ * @brief Every setting is optional; the defaults leave the thread untouched.
+ **/
+class IcsRtPolicy
+{
+  // Type definitions within the class
+public:
+  /**
+   * @enum Scheduler
+   * @brief Scheduling class of the thread
+   **/
+  enum Scheduler
+  {
+    RT_SCHED_UNCHANGED = 0, ///< Keep the current class (normally SCHED_OTHER/CFS)
+    RT_SCHED_FIFO = 1,      ///< SCHED_FIFO with #priority
+    RT_SCHED_DEADLINE = 2   ///< SCHED_DEADLINE with #runtimeNs / #deadlineNs / #periodNs
+  };
+
+  // Variables
+public:
+  Scheduler scheduler = RT_SCHED_UNCHANGED; ///< Scheduling class
+  int priority = 80;                        ///< SCHED_FIFO priority (1 to 99)
+  unsigned long long runtimeNs = 0;         ///< SCHED_DEADLINE budget per period
+  unsigned long long deadlineNs = 0;        ///< SCHED_DEADLINE relative deadline (0: same as the period)
+  unsigned long long periodNs = 0;          ///< SCHED_DEADLINE period
+  std::vector<int> cpus;                    ///< CPUs the thread may run on (empty: unchanged, online CPU indices)
+  bool lockMemory = false;                  ///< mlockall(MCL_CURRENT | MCL_FUTURE), process wide
+  size_t prefaultStackBytes = 0;            ///< Bytes of stack to touch so later growth does not page fault
+  long timerSlackNs = -1;                   ///< PR_SET_TIMERSLACK value (negative: unchanged, 1 is the minimum)
+
+  // Functions
+public:
+  IcsRtReport apply() const;
+  IcsRtReport check() const;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ *  @file IcsServoModel.h
+ * @brief Position, current and temperature response of an emulated servo
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Servo_Model_h_
+#define _ics_Servo_Model_h_
+
+struct IcsSimServo;
+
+// IcsServoModel class ///////////////////////////////////////////////////
+/**
+ * @class IcsServoModel
+ * @brief Simple servo dynamics for IcsServoSim
+ * @brief The horn follows the position command with a first or second order response. Stretch (SC 0x01) sets the
+ *        stiffness, speed (SC 0x02) the maximum velocity. Current follows the load of the position loop and heats
+ *        the motor, which cools towards the ambient temperature.
+ * @note The defaults are in the range of a KRS-2552RHV. They are meant to be plausible, not a calibrated model.
+ **/
+class IcsServoModel
+{
+  // Type definitions within the class
+public:
+  /**
+   * @enum Order
+   * @brief Kind of position response
+   **/
+  enum Order
+  {
+    MODEL_NONE = 0,        ///< The position jumps to the command (protocol tests)
+    MODEL_FIRST_ORDER = 1, ///< Exponential approach with a velocity limit
+    MODEL_SECOND_ORDER = 2 ///< Damped spring with a velocity limit, can overshoot
+  };
+
+  // Variables
+public:
+  Order order = MODEL_FIRST_ORDER;     ///< Response type
+  double maxSpeed = 12700.0;           ///< Velocity limit at speed 127 (position units/s, about 430 deg/s)
+  double timeConstant = 0.02;          ///< First order time constant at stretch 127 (s)
+  double naturalFreq = 50.0;           ///< Second order natural frequency at stretch 127 (rad/s)
+  double damping = 0.7;                ///< Second order damping ratio
+  double currentIdle = 1.0;            ///< Current readout at rest
+  double currentPerError = 0.02;       ///< Current readout per position unit of error at stretch 127
+  double ambient = 25.0;               ///< Ambient temperature (deg C)
+  double heating = 0.0025;             ///< Temperature rise per second per (current readout)^2 (deg C)
+  double coolingTime = 120.0;          ///< Thermal time constant (s)
+  long long maxStepNs = 1000000;       ///< Longest integration step (ns)
+
+  // Functions
+public:
+  void reset(IcsSimServo &servo) const;
+  void step(IcsSimServo &servo, long long dtNs) const;
+
+  static int temperatureReadout(double celsius);
+
+protected:
+  void integrate(IcsSimServo &servo, double dt) const;
+};
+
+#endif
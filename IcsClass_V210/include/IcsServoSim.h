@@ -0,0 +1,181 @@
+/**
+ *  @file IcsServoSim.h
+ * @brief ICS3.5/3.6 servo chain emulated behind a pseudo-terminal
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Servo_Sim_h_
+#define _ics_Servo_Sim_h_
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IcsTimingModel.h"
+#include "IcsServoModel.h"
+
+/**
+ * @struct IcsSimServo
+ * @brief State of one emulated servo
+ **/
+struct IcsSimServo
+{
+  unsigned char id = 0;            ///< Servo ID (0-31)
+  int pos = 7500;                  ///< Current position
+  int target = 7500;               ///< Last position command
+  bool free = false;               ///< True after a free (position 0) command
+  unsigned char stretch = 60;      ///< Stretch (SC 0x01)
+  unsigned char speed = 127;       ///< Speed (SC 0x02)
+  unsigned char currentLimit = 63; ///< Current limit (write SC 0x03)
+  unsigned char tmpLimit = 80;     ///< Temperature limit (write SC 0x04)
+  unsigned char current = 0;       ///< Current readout (read SC 0x03)
+  unsigned char temperature = 80;  ///< Temperature readout (read SC 0x04), lower is hotter
+  double exactPos = 7500.0;        ///< Model position, pos is this rounded
+  double velocity = 0.0;           ///< Model velocity (position units/s)
+  double celsius = 25.0;           ///< Model motor temperature (deg C)
+};
+
+/**
+ * @struct IcsSimFaults
+ * @brief Faults the emulated chain injects, drawn from a seeded generator so a run can be repeated exactly
+ * @note Probabilities are per reply byte for byteLoss, parityError and bitFlip, and per servo reply for the others.
+ **/
+struct IcsSimFaults
+{
+  unsigned int seed = 1;         ///< Seed of the fault generator, applied by setFaults()
+  double byteLoss = 0.0;         ///< A reply byte never reaches the receiver (its time slot still passes)
+  double parityError = 0.0;      ///< A reply byte is hit by a single bit error and dropped like the driver does (IGNPAR)
+  double bitFlip = 0.0;          ///< A reply byte arrives with one bit flipped (a pty has no parity to catch it)
+  double lateReply = 0.0;        ///< A reply starts lateDelayNs later than it should
+  long long lateDelayNs = 0;     ///< Extra delay of a late reply, e.g. longer than the library timeout (ns)
+  double duplicateReply = 0.0;   ///< A second servo with the same ID answers too, right after the first
+  double silent = 0.0;           ///< A servo ignores a command addressed to it
+  unsigned long silentMask = 0;  ///< Servos that never answer (bit n: ID n)
+};
+
+/**
+ * @struct IcsSimStats
+ * @brief What the emulated chain has seen
+ **/
+struct IcsSimStats
+{
+  unsigned long frames = 0;       ///< Complete commands received
+  unsigned long replies = 0;      ///< Replies sent (one per answering servo)
+  unsigned long unanswered = 0;   ///< Commands for an ID nobody has
+  unsigned long garbageBytes = 0; ///< Bytes that could not start a command
+  unsigned long brokenFrames = 0; ///< Commands abandoned after a gap in the middle
+  unsigned long lostBytes = 0;    ///< Injected: reply bytes lost
+  unsigned long parityErrors = 0; ///< Injected: reply bytes dropped for a parity error
+  unsigned long flippedBytes = 0; ///< Injected: reply bytes with a flipped bit
+  unsigned long lateReplies = 0;  ///< Injected: delayed replies
+  unsigned long duplicates = 0;   ///< Injected: replies answered twice
+  unsigned long silences = 0;     ///< Injected: commands a servo ignored
+};
+
+// IcsServoSim class ///////////////////////////////////////////////////
+/**
+ * @class IcsServoSim
+ * @brief Up to 32 ICS servos answering on the slave side of a pty, for testing without a Raspberry Pi
+ * @brief Open getDevice() with IcsHardSerialClass like a UART. Replies are byte-exact and timed like the real wire:
+ *        the reply starts one turnaround after the last command byte would have arrived at the configured baud rate,
+ *        and the bytes are handed out one character time apart.
+ * @note Without wiringPi the library is built with the GPIO stub, so the enable pin costs nothing.
+ * @note Positions, current and temperature follow IcsServoModel. The model clock can run faster than real time
+ *       (setTimeScale()) or be stepped by hand (setManualClock(), advance()).
+ * @note Two servos with the same ID are emulated by adding the ID twice. Both reply, one after the other.
+ * @note EEPROM commands (sub command 0x00) are not emulated.
+ **/
+class IcsServoSim
+{
+  // Constructor, Destructor
+public:
+  // Constructor
+  IcsServoSim(unsigned int baudrate = 115200);
+
+  // Descructor
+  ~IcsServoSim();
+
+  // Variables
+protected:
+  int master_fd = -1;                        ///< Master side of the pty (the servo end)
+  int slave_fd = -1;                         ///< Slave side, held open so the pty survives reconnects
+  std::string device;                        ///< Slave device path
+  IcsTimingModel timing_default;             ///< Character timing at the emulated baud rate
+  long long turnaround_ns = 100000;          ///< Servo processing time before the reply (ns)
+  long long frame_gap_ns = 0;                ///< Silence that aborts a partial command (ns)
+  bool paced = true;                         ///< Hand out reply bytes one character time apart
+  std::vector<IcsSimServo> servos;           ///< Chain, several entries may share an ID
+  IcsSimFaults faults_default;               ///< Faults to inject
+  IcsServoModel model_default;               ///< Dynamics of all servos on the chain
+  double time_scale = 1.0;                   ///< Model seconds per wall clock second
+  bool manual_clock = false;                 ///< Model time only moves with advance()
+  long long model_time_ns = 0;               ///< Model time (ns)
+  long long model_wall_ns = 0;               ///< Wall clock of the last model update (ns)
+  std::mt19937 rng_default;                  ///< Fault generator (the engine is fully specified, unlike the distributions)
+  IcsSimStats stats_default;                 ///< Counters
+  mutable std::mutex lock;                   ///< Protects servos, stats_default and the settings
+  std::thread thread;                        ///< Emulation thread
+  std::atomic<bool> running{false};          ///< Cleared by stop()
+
+  // Functions
+public:
+  bool open();
+  const char *getDevice() const;
+  bool start();
+  void stop();
+
+  // Chain setup
+public:
+  void addServo(unsigned char id, int pos = 7500);
+  void addServos(int count);
+  bool removeServo(unsigned char id);
+  bool getServo(unsigned char id, IcsSimServo &servo);
+  bool setServo(const IcsSimServo &servo);
+  int getServoCount() const;
+
+  // Timing
+public:
+  void setBaudrate(unsigned int baudrate);
+  unsigned int getBaudrate() const;
+  void setTurnaround(long long ns);
+  long long getTurnaround() const;
+  void setPaced(bool enable);
+
+  // Servo dynamics
+public:
+  void setModel(const IcsServoModel &model);
+  IcsServoModel getModel() const;
+  void setTimeScale(double scale);
+  void setManualClock(bool enable);
+  void advance(long long ns);
+  long long getModelTimeNs() const;
+
+  // Fault injection
+public:
+  void setFaults(const IcsSimFaults &faults);
+  IcsSimFaults getFaults() const;
+
+  // Statistics
+public:
+  IcsSimStats getStats() const;
+  void resetStats();
+
+  static int frameLength(unsigned char cmd);
+
+protected:
+  void emulationLoop();
+  int answer(const unsigned char *rxBuf, int rxLen, unsigned char *txBuf);
+  int answerServo(IcsSimServo &servo, const unsigned char *rxBuf, unsigned char *txBuf);
+  void updateModel();
+  bool chance(double p);
+  long long injectFaults(unsigned char *txBuf, bool *lost, int txLen, long long startNs);
+  void sendReply(const unsigned char *txBuf, const bool *lost, int txLen, long long startNs);
+};
+
+#endif
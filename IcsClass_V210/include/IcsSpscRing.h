@@ -0,0 +1,98 @@
+/**
+ *  @file IcsSpscRing.h
+ * @brief Bounded lock-free single-producer/single-consumer ring
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Spsc_Ring_h_
+#define _ics_Spsc_Ring_h_
+
+#include <atomic>
+#include <cstddef>
+
+// IcsSpscRing class ///////////////////////////////////////////////////
+/**
+ * @class IcsSpscRing
+ * @brief Fixed-size ring for handing data between exactly one producer thread and one consumer thread
+ * @brief No locks and no allocation: push() and pop() never block, they fail when the ring is full or empty
+ * @tparam T Element type (copied in and out)
+ * @tparam N Capacity, must be a power of two
+ **/
+template <typename T, size_t N>
+class IcsSpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "IcsSpscRing capacity must be a power of two");
+
+  // Fixed value (published)
+public:
+  static constexpr size_t CACHE_LINE = 64; ///< Indices written by different threads are kept this far apart
+  static constexpr size_t CAPACITY = N;    ///< Number of elements the ring can hold
+
+  // Variables
+protected:
+  // Padding rather than alignas, so the ring can live in heap objects without C++17 aligned new
+  char pad_front[CACHE_LINE];                              ///< Keeps head away from whatever precedes the ring
+  std::atomic<size_t> head{0};                             ///< Next slot to read, written by the consumer only
+  char pad_head[CACHE_LINE - sizeof(std::atomic<size_t>)]; ///< Keeps head and tail on different cache lines
+  std::atomic<size_t> tail{0};                             ///< Next slot to write, written by the producer only
+  char pad_tail[CACHE_LINE - sizeof(std::atomic<size_t>)]; ///< Keeps tail away from the slots
+  T slots[N];                                              ///< Storage
+
+  // Functions
+public:
+  /**
+   * @brief Append an element (producer thread only)
+   * @param[in] value Element to copy in
+   * @retval true Stored
+   * @retval false Ring full
+   **/
+  bool push(const T &value)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= N)
+      return false;
+    slots[t & (N - 1)] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Take the oldest element (consumer thread only)
+   * @param[out] value Element copied out
+   * @retval true An element was returned
+   * @retval false Ring empty
+   **/
+  bool pop(T &value)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+    value = slots[h & (N - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Number of elements currently stored (approximate while the other side is active)
+   * @return Element count
+   **/
+  size_t size() const
+  {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Check whether the ring is empty
+   * @retval true No element stored
+   **/
+  bool empty() const
+  {
+    return size() == 0;
+  }
+};
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ *  @file IcsTimingModel.h
+ * @brief Wire timing of ICS transactions derived from the baud rate
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Timing_Model_h_
+#define _ics_Timing_Model_h_
+
+/**
+ * @struct IcsTransactionTiming
+ * @brief Expected durations of one command/reply exchange (all values in ns)
+ **/
+struct IcsTransactionTiming
+{
+  unsigned int bitNs;       ///< Duration of one bit
+  unsigned int charNs;      ///< Duration of one 8E1 character (start + 8 data + parity + stop)
+  unsigned int txWireNs;    ///< Time to shift out the whole command
+  unsigned int rxWireNs;    ///< Time to shift in the whole reply
+  unsigned int txSleepNs;   ///< Time that can be slept right after write() before checking the transmitter
+  unsigned int txReleaseNs; ///< Time after write() at which the enable pin can be dropped when the transmitter cannot be queried
+};
+
+// IcsTimingModel class ///////////////////////////////////////////////////
+/**
+ * @class IcsTimingModel
+ * @brief Computes ICS frame and transaction durations for any baud rate (including custom BOTHER rates)
+ **/
+class IcsTimingModel
+{
+  // Fixed value (published)
+public:
+  static constexpr unsigned int BITS_PER_CHAR = 11; ///< 1 start + 8 data + 1 even parity + 1 stop bit
+
+  // Constructor
+public:
+  IcsTimingModel(unsigned int baudrate = 115200);
+
+  // Variables
+protected:
+  unsigned int baudrate_default = 115200; ///< Baud rate the model was built for
+
+  // Functions
+public:
+  unsigned int getBaudrate() const;
+  unsigned int bitNs() const;
+  unsigned int charNs() const;
+  unsigned int wireNs(unsigned int chars) const;
+  IcsTransactionTiming transaction(unsigned char txLen, unsigned char rxLen) const;
+};
+
+#endif
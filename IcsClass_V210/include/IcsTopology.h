@@ -0,0 +1,136 @@
+/**
+ *  @file IcsTopology.h
+ * @brief Robot description file: buses, joints, servo models and timing
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Topology_h_
+#define _ics_Topology_h_
+
+#include <string>
+#include <vector>
+#include "IcsCalibration.h"
+
+class IcsBusHub;
+
+/**
+ * @struct IcsTopologyBus
+ * @brief One [bus.name] section. Negative numbers (and baudrate 0) mean "use the [robot] default or the library default".
+ **/
+struct IcsTopologyBus
+{
+  std::string name;            ///< Section name after "bus."
+  std::string device;          ///< UART device, e.g. /dev/ttyAMA1
+  int enpin = -1;              ///< Enable pin (BCM), default IcsHardSerialClass::defaultEnablePin(device)
+  unsigned int baudrate = 0;   ///< Baud rate
+  int timeout = -1;            ///< Reply timeout (ms)
+  int interByteTimeoutUs = -1; ///< Largest gap inside a reply (us)
+  int rxMode = -1;             ///< IcsHardSerialClass::RxMode ("spin", "poll")
+  int dirMode = -1;            ///< IcsHardSerialClass::DirMode ("gpio", "rs485")
+};
+
+/**
+ * @struct IcsTopologyModel
+ * @brief One [model.name] section: settings written to every servo of that model. -1 leaves the servo as it is.
+ **/
+struct IcsTopologyModel
+{
+  std::string name;          ///< Section name after "model."
+  int stretch = -1;          ///< setStrc() value (1-127)
+  int speed = -1;            ///< setSpd() value (1-127)
+  int currentLimit = -1;     ///< setCur() value (1-63)
+  int temperatureLimit = -1; ///< setTmp() value (1-127)
+};
+
+/**
+ * @struct IcsTopologyJoint
+ * @brief One joint, from a [joint.name] section or from the ids list of a bus
+ **/
+struct IcsTopologyJoint
+{
+  std::string name;                ///< Section name after "joint.", or "bus.id" for ids lists
+  int bus = -1;                    ///< Index into the buses (and IcsBusHub bus index after build())
+  unsigned char id = 0;            ///< Servo ID
+  int model = -1;                  ///< Index into the models, -1 for none
+  IcsJointCalibration calibration; ///< Joint calibration (offset, sign, gear, limits), only the offset for a mirror
+  bool calibrated = false;         ///< The section set calibration values (otherwise the calibration file applies)
+  int mirror = -1;                 ///< Joint whose calibration this one mirrors (IcsCalibration::mirror()), -1 for none
+};
+
+// IcsTopology class ///////////////////////////////////////////////////
+/**
+ * @class IcsTopology
+ * @brief Reads the wiring of a robot from an INI file and builds the IcsBusHub, the IcsCalibration and the servo setup
+ * @brief Sections and keys (angles in degrees, '#' or ';' start a comment):
+ *        [robot]       baudrate, timeout, oe_pin (level shifter enable, driven high by build()), calibration (file)
+ *        [bus.NAME]    device, enpin, baudrate, timeout, interbyte_timeout_us, rx_mode, dir_mode, ids, model
+ *        [model.NAME]  stretch, speed, current_limit, temperature_limit
+ *        [joint.NAME]  bus, id, model, offset, sign, gear, min, max, mirror (joint name)
+ * @note A mirror joint takes sign, gear and limits from the joint it mirrors, as calibrated after the calibration file,
+ *       and sets its own offset only.
+ * @note Joints are numbered in the order they appear, ids lists first-come like joint sections. That order is the
+ *       joint order of the hub and of the calibration.
+ **/
+class IcsTopology
+{
+  // Constructor
+public:
+  IcsTopology();
+
+  // Variables
+protected:
+  unsigned int baudrate_default = 115200;  ///< [robot] baudrate
+  int timeout_default = 100;               ///< [robot] timeout (ms)
+  int oe_pin = -1;                         ///< [robot] oe_pin, -1 for none
+  std::string calibration_file;            ///< [robot] calibration, relative to the topology file
+  std::vector<IcsTopologyBus> buses;       ///< Buses in file order
+  std::vector<IcsTopologyModel> models;    ///< Servo models in file order
+  std::vector<IcsTopologyJoint> joints;    ///< Joints in file order
+
+  // Names as written, resolved to indices once the whole file is read
+  std::vector<std::string> bus_models;     ///< Model of the ids joints of each bus
+  std::vector<std::string> joint_buses;    ///< Bus of each joint
+  std::vector<std::string> joint_models;   ///< Model of each joint ("" for the bus model or none)
+  std::vector<std::string> joint_mirrors;  ///< Joint mirrored by each joint ("" for none)
+  std::vector<bool> joint_shapes;          ///< The joint section set sign, gear, min or max (not allowed with mirror)
+
+  // Where each bus and joint was declared, for the messages of resolve()
+  std::vector<int> bus_lines;              ///< Line of each [bus.NAME] section
+  std::vector<int> joint_lines;            ///< Line of each [joint.NAME] section or ids key
+
+  // Functions
+public:
+  bool load(const char *path);
+  bool parse(const std::string &text, const char *source = "topology");
+
+  int getBusCount() const;
+  int getJointCount() const;
+  int getModelCount() const;
+  const IcsTopologyBus &getBus(int bus) const;
+  const IcsTopologyJoint &getJoint(int joint) const;
+  const IcsTopologyModel &getModel(int model) const;
+  int findBus(const std::string &name) const;
+  int findJoint(const std::string &name) const;
+  int findModel(const std::string &name) const;
+
+  unsigned int getBaudrate(int bus) const;
+  int getTimeout(int bus) const;
+  int getEnablePin(int bus) const;
+  int getOePin() const;
+
+  // Building
+  bool build(IcsBusHub &hub) const;
+  bool buildCalibration(IcsCalibration &calibration) const;
+  int applyModels(IcsBusHub &hub) const;
+
+protected:
+  void clear();
+  bool setKey(const std::string &section, const std::string &key, const std::string &value, std::string &error);
+  bool resolve(std::string &error, int &line);
+};
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ *@file IcsAngleBatch.cpp
+ *@brief Angle conversion of whole joint arrays
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsBaseClass.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define ICS_BATCH_X86 1
+#endif
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define ICS_BATCH_NEON 1
+#endif
+
+// The kernels do the same IEEE operations as the scalar functions (float -> double, multiply or divide by the
+// double 29.633, truncate or round to float), so the results are bit-exact. Only the range check differs for NaN:
+// degPos() converts it (undefined), the batch functions report it as out of range.
+
+namespace
+{
+  const double POS_PER_DEG = 29.633; // Same constant as degPos()/posDeg()
+  const int POS_CENTER = 7500;       // Position at 0 deg
+  const float DEG_LIMIT = 180.0f;    // IcsBaseClass::MAX_DEG (-MIN_DEG)
+  const float DEG_FALSE = 9999.9f;   // IcsBaseClass::ANGLE_F_FALSE
+
+  // Clear the mask words of count entries
+  void clearMask(unsigned int *mask, int count)
+  {
+    if (!mask)
+      return;
+    for (int w = 0; w < (count + 31) / 32; w++)
+      mask[w] = 0;
+  }
+
+  // Set the out-of-range bits of up to 8 entries starting at index (bits holds one bit per entry)
+  inline void setMask(unsigned int *mask, int index, unsigned int bits)
+  {
+    if (!mask || !bits)
+      return;
+    mask[index / 32] |= bits << (index % 32);
+    if (index % 32 > 24 && (bits >> (32 - index % 32)))
+      mask[index / 32 + 1] |= bits >> (32 - index % 32);
+  }
+
+  // Scalar kernels, also used for the tails of the vector loops
+  int degPosScalar(const float *deg, int *pos, int begin, int count, unsigned int *mask)
+  {
+    int bad = 0;
+    for (int i = begin; i < count; i++)
+    {
+      float d = deg[i];
+      if (!(d <= DEG_LIMIT && d >= -DEG_LIMIT))
+      {
+        pos[i] = -1;
+        setMask(mask, i, 1);
+        bad++;
+        continue;
+      }
+      pos[i] = (int)(d * POS_PER_DEG) + POS_CENTER;
+    }
+    return bad;
+  }
+
+  int posDegScalar(const int *pos, float *deg, int begin, int count, unsigned int *mask)
+  {
+    int bad = 0;
+    for (int i = begin; i < count; i++)
+    {
+      float d = (pos[i] - POS_CENTER) / POS_PER_DEG;
+      if (d > DEG_LIMIT || d < -DEG_LIMIT)
+      {
+        d = (d > 0) ? DEG_FALSE : -DEG_FALSE;
+        setMask(mask, i, 1);
+        bad++;
+      }
+      deg[i] = d;
+    }
+    return bad;
+  }
+
+#if ICS_BATCH_X86
+  // SSE2, 4 joints per step (baseline on x86-64)
+  int degPosSse2(const float *deg, int *pos, int count, unsigned int *mask)
+  {
+    const __m128 hi = _mm_set1_ps(DEG_LIMIT);
+    const __m128 lo = _mm_set1_ps(-DEG_LIMIT);
+    const __m128d scale = _mm_set1_pd(POS_PER_DEG);
+    const __m128i center = _mm_set1_epi32(POS_CENTER);
+    int bad = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128 d = _mm_loadu_ps(deg + i);
+      __m128 ok = _mm_and_ps(_mm_cmple_ps(d, hi), _mm_cmpge_ps(d, lo));
+      __m128i p0 = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(d), scale));
+      __m128i p1 = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(d, d)), scale));
+      __m128i p = _mm_add_epi32(_mm_unpacklo_epi64(p0, p1), center);
+      p = _mm_or_si128(p, _mm_xor_si128(_mm_castps_si128(ok), _mm_set1_epi32(-1))); // -1 where out of range
+      _mm_storeu_si128((__m128i *)(pos + i), p);
+
+      unsigned int bits = ~_mm_movemask_ps(ok) & 0xF;
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + degPosScalar(deg, pos, i, count, mask);
+  }
+
+  int posDegSse2(const int *pos, float *deg, int count, unsigned int *mask)
+  {
+    const __m128 hi = _mm_set1_ps(DEG_LIMIT);
+    const __m128 lo = _mm_set1_ps(-DEG_LIMIT);
+    const __m128 falseHi = _mm_set1_ps(DEG_FALSE);
+    const __m128 falseLo = _mm_set1_ps(-DEG_FALSE);
+    const __m128d scale = _mm_set1_pd(POS_PER_DEG);
+    const __m128i center = _mm_set1_epi32(POS_CENTER);
+    int bad = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128i p = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pos + i)), center);
+      __m128 d0 = _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(p), scale));
+      __m128 d1 = _mm_cvtpd_ps(_mm_div_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(p, p)), scale));
+      __m128 d = _mm_movelh_ps(d0, d1);
+      __m128 over = _mm_cmpgt_ps(d, hi);
+      __m128 under = _mm_cmplt_ps(d, lo);
+      d = _mm_or_ps(_mm_andnot_ps(_mm_or_ps(over, under), d),
+                    _mm_or_ps(_mm_and_ps(over, falseHi), _mm_and_ps(under, falseLo)));
+      _mm_storeu_ps(deg + i, d);
+
+      unsigned int bits = _mm_movemask_ps(_mm_or_ps(over, under));
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + posDegScalar(pos, deg, i, count, mask);
+  }
+
+  // AVX2, 8 joints per step, chosen at run time so the library still runs on CPUs without it
+  __attribute__((target("avx2"))) int degPosAvx2(const float *deg, int *pos, int count, unsigned int *mask)
+  {
+    const __m256 hi = _mm256_set1_ps(DEG_LIMIT);
+    const __m256 lo = _mm256_set1_ps(-DEG_LIMIT);
+    const __m256d scale = _mm256_set1_pd(POS_PER_DEG);
+    const __m256i center = _mm256_set1_epi32(POS_CENTER);
+    int bad = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+      __m256 d = _mm256_loadu_ps(deg + i);
+      __m256 ok = _mm256_and_ps(_mm256_cmp_ps(d, hi, _CMP_LE_OQ), _mm256_cmp_ps(d, lo, _CMP_GE_OQ));
+      __m128i p0 = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(d)), scale));
+      __m128i p1 = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)), scale));
+      __m256i p = _mm256_add_epi32(_mm256_inserti128_si256(_mm256_castsi128_si256(p0), p1, 1), center);
+      p = _mm256_or_si256(p, _mm256_xor_si256(_mm256_castps_si256(ok), _mm256_set1_epi32(-1)));
+      _mm256_storeu_si256((__m256i *)(pos + i), p);
+
+      unsigned int bits = ~_mm256_movemask_ps(ok) & 0xFF;
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + degPosScalar(deg, pos, i, count, mask);
+  }
+
+  __attribute__((target("avx2"))) int posDegAvx2(const int *pos, float *deg, int count, unsigned int *mask)
+  {
+    const __m256 hi = _mm256_set1_ps(DEG_LIMIT);
+    const __m256 lo = _mm256_set1_ps(-DEG_LIMIT);
+    const __m256 falseHi = _mm256_set1_ps(DEG_FALSE);
+    const __m256 falseLo = _mm256_set1_ps(-DEG_FALSE);
+    const __m256d scale = _mm256_set1_pd(POS_PER_DEG);
+    const __m256i center = _mm256_set1_epi32(POS_CENTER);
+    int bad = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+      __m256i p = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pos + i)), center);
+      __m128 d0 = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(p)), scale));
+      __m128 d1 = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(p, 1)), scale));
+      __m256 d = _mm256_insertf128_ps(_mm256_castps128_ps256(d0), d1, 1);
+      __m256 over = _mm256_cmp_ps(d, hi, _CMP_GT_OQ);
+      __m256 under = _mm256_cmp_ps(d, lo, _CMP_LT_OQ);
+      d = _mm256_blendv_ps(d, falseHi, over);
+      d = _mm256_blendv_ps(d, falseLo, under);
+      _mm256_storeu_ps(deg + i, d);
+
+      unsigned int bits = _mm256_movemask_ps(_mm256_or_ps(over, under));
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + posDegScalar(pos, deg, i, count, mask);
+  }
+
+  bool hasAvx2()
+  {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+  }
+#endif
+
+#if ICS_BATCH_NEON
+  // NEON, 4 joints per step (double lanes need aarch64, 32-bit ARM uses the scalar kernels)
+  int degPosNeon(const float *deg, int *pos, int count, unsigned int *mask)
+  {
+    const float32x4_t hi = vdupq_n_f32(DEG_LIMIT);
+    const float32x4_t lo = vdupq_n_f32(-DEG_LIMIT);
+    const float64x2_t scale = vdupq_n_f64(POS_PER_DEG);
+    const int32x4_t center = vdupq_n_s32(POS_CENTER);
+    const uint32x4_t laneBits = {1, 2, 4, 8};
+    int bad = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+      float32x4_t d = vld1q_f32(deg + i);
+      uint32x4_t ok = vandq_u32(vcleq_f32(d, hi), vcgeq_f32(d, lo));
+      int64x2_t p0 = vcvtq_s64_f64(vmulq_f64(vcvt_f64_f32(vget_low_f32(d)), scale));
+      int64x2_t p1 = vcvtq_s64_f64(vmulq_f64(vcvt_high_f64_f32(d), scale));
+      int32x4_t p = vaddq_s32(vcombine_s32(vmovn_s64(p0), vmovn_s64(p1)), center);
+      p = vorrq_s32(p, vreinterpretq_s32_u32(vmvnq_u32(ok))); // -1 where out of range
+      vst1q_s32(pos + i, p);
+
+      unsigned int bits = vaddvq_u32(vbicq_u32(laneBits, ok));
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + degPosScalar(deg, pos, i, count, mask);
+  }
+
+  int posDegNeon(const int *pos, float *deg, int count, unsigned int *mask)
+  {
+    const float32x4_t hi = vdupq_n_f32(DEG_LIMIT);
+    const float32x4_t lo = vdupq_n_f32(-DEG_LIMIT);
+    const float32x4_t falseHi = vdupq_n_f32(DEG_FALSE);
+    const float32x4_t falseLo = vdupq_n_f32(-DEG_FALSE);
+    const float64x2_t scale = vdupq_n_f64(POS_PER_DEG);
+    const int32x4_t center = vdupq_n_s32(POS_CENTER);
+    const uint32x4_t laneBits = {1, 2, 4, 8};
+    int bad = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+      int32x4_t p = vsubq_s32(vld1q_s32(pos + i), center);
+      float64x2_t d0 = vdivq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(p))), scale);
+      float64x2_t d1 = vdivq_f64(vcvtq_f64_s64(vmovl_high_s32(p)), scale);
+      float32x4_t d = vcvt_high_f32_f64(vcvt_f32_f64(d0), d1);
+      uint32x4_t over = vcgtq_f32(d, hi);
+      uint32x4_t under = vcltq_f32(d, lo);
+      d = vbslq_f32(over, falseHi, d);
+      d = vbslq_f32(under, falseLo, d);
+      vst1q_f32(deg + i, d);
+
+      unsigned int bits = vaddvq_u32(vandq_u32(laneBits, vorrq_u32(over, under)));
+      if (bits)
+      {
+        setMask(mask, i, bits);
+        bad += __builtin_popcount(bits);
+      }
+    }
+    return bad + posDegScalar(pos, deg, i, count, mask);
+  }
+#endif
+}
+
+// Angle conversion of a joint array, angle to POS ///////////////////////////////////////////////////////////////
+/**
+ *@brief Convert an array of angles (float type) to position data, like degPos() for every entry
+ *@param[in] *deg Angles (deg)
+ *@param[out] *pos Position data, -1 for entries out of range
+ *@param[in] count Number of entries
+ *@param[out] *mask Optional out-of-range bits, bit (i % 32) of mask[i / 32] for entry i. (count + 31) / 32 words.
+ *@return Number of entries out of range
+ *@note NaN counts as out of range.
+ **/
+int IcsBaseClass::degPosBatch(const float *deg, int *pos, int count, unsigned int *mask)
+{
+  clearMask(mask, count);
+#if ICS_BATCH_X86
+  if (hasAvx2())
+    return degPosAvx2(deg, pos, count, mask);
+  return degPosSse2(deg, pos, count, mask);
+#elif ICS_BATCH_NEON
+  return degPosNeon(deg, pos, count, mask);
+#else
+  return degPosScalar(deg, pos, 0, count, mask);
+#endif
+}
+
+// Angle conversion of a joint array, POS to angle ///////////////////////////////////////////////////////////////
+/**
+ *@brief Convert an array of position data to angles (float type), like posDeg() for every entry
+ *@param[in] *pos Position data
+ *@param[out] *deg Angles (deg), ±#ANGLE_F_FALSE for entries out of range
+ *@param[in] count Number of entries
+ *@param[out] *mask Optional out-of-range bits, bit (i % 32) of mask[i / 32] for entry i. (count + 31) / 32 words.
+ *@return Number of entries out of range
+ **/
+int IcsBaseClass::posDegBatch(const int *pos, float *deg, int count, unsigned int *mask)
+{
+  clearMask(mask, count);
+#if ICS_BATCH_X86
+  if (hasAvx2())
+    return posDegAvx2(pos, deg, count, mask);
+  return posDegSse2(pos, deg, count, mask);
+#elif ICS_BATCH_NEON
+  return posDegNeon(pos, deg, count, mask);
+#else
+  return posDegScalar(pos, deg, 0, count, mask);
+#endif
+}
+
+/**
+ *@brief Name of the kernel used by degPosBatch()/posDegBatch() on this machine
+ *@return "avx2", "sse2", "neon" or "scalar"
+ **/
+const char *IcsBaseClass::batchKernel()
+{
+#if ICS_BATCH_X86
+  return hasAvx2() ? "avx2" : "sse2";
+#elif ICS_BATCH_NEON
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
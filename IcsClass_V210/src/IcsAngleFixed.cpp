@@ -0,0 +1,60 @@
+/**
+ *@file IcsAngleFixed.cpp
+ *@brief Exact, divide-free conversion between servo positions and angles x100
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsAngleFixed.h"
+
+// Definitions of the constants, so they may also be passed by reference
+constexpr int IcsAngleFixed::POS_MIN;
+constexpr int IcsAngleFixed::POS_MAX;
+constexpr int IcsAngleFixed::POS_CENTER;
+constexpr int IcsAngleFixed::DEG100_MIN;
+constexpr int IcsAngleFixed::DEG100_MAX;
+constexpr int IcsAngleFixed::POS_FALSE;
+constexpr int IcsAngleFixed::DEG100_FALSE;
+constexpr int IcsAngleFixed::RECIP_SHIFT;
+constexpr unsigned long long IcsAngleFixed::RECIP_27;
+
+// Exhaustive compile-time checks. The ranges are split in halves so the recursion stays about 15 calls deep.
+namespace
+{
+  // Every position comes back from its angle, and neighbouring positions never share an angle
+  constexpr bool roundTrip(int lo, int hi)
+  {
+    return (lo == hi) ? (IcsAngleFixed::toPos(IcsAngleFixed::toDeg100(lo)) == lo &&
+                         (lo == IcsAngleFixed::POS_MIN || IcsAngleFixed::toDeg100(lo) > IcsAngleFixed::toDeg100(lo - 1)))
+                      : roundTrip(lo, lo + (hi - lo) / 2) && roundTrip(lo + (hi - lo) / 2 + 1, hi);
+  }
+
+  // The multiply-shift equals the rounded division for every angle in range
+  constexpr bool nearestPos(int lo, int hi)
+  {
+    return (lo == hi) ? (IcsAngleFixed::toPos(lo) ==
+                         IcsAngleFixed::POS_MIN + ((lo - IcsAngleFixed::DEG100_MIN) * 8 + 13) / 27)
+                      : nearestPos(lo, lo + (hi - lo) / 2) && nearestPos(lo + (hi - lo) / 2 + 1, hi);
+  }
+
+  // The rounded product equals the exact ratio to within half a step (deg x100 scaled by 8)
+  constexpr bool nearestDeg100(int lo, int hi)
+  {
+    return (lo == hi) ? ((IcsAngleFixed::toDeg100(lo) - IcsAngleFixed::DEG100_MIN) * 8 - (lo - IcsAngleFixed::POS_MIN) * 27 <= 4 &&
+                         (IcsAngleFixed::toDeg100(lo) - IcsAngleFixed::DEG100_MIN) * 8 - (lo - IcsAngleFixed::POS_MIN) * 27 >= -4)
+                      : nearestDeg100(lo, lo + (hi - lo) / 2) && nearestDeg100(lo + (hi - lo) / 2 + 1, hi);
+  }
+}
+
+static_assert(roundTrip(IcsAngleFixed::POS_MIN, IcsAngleFixed::POS_MAX), "toPos() must invert toDeg100() for every position");
+static_assert(nearestPos(IcsAngleFixed::DEG100_MIN, IcsAngleFixed::DEG100_MAX), "toPos() must round to the nearest position");
+static_assert(nearestDeg100(IcsAngleFixed::POS_MIN, IcsAngleFixed::POS_MAX), "toDeg100() must round to the nearest 0.01 deg");
+static_assert(IcsAngleFixed::toDeg100(IcsAngleFixed::POS_CENTER) == 0 && IcsAngleFixed::toPos(0) == IcsAngleFixed::POS_CENTER, "0 deg is the centre");
+static_assert(IcsAngleFixed::toDeg100(IcsAngleFixed::POS_MIN - 1) == -IcsAngleFixed::DEG100_FALSE &&
+                  IcsAngleFixed::toDeg100(IcsAngleFixed::POS_MAX + 1) == IcsAngleFixed::DEG100_FALSE,
+              "positions out of range");
+static_assert(IcsAngleFixed::toPos(IcsAngleFixed::DEG100_MIN - 1) == IcsAngleFixed::POS_FALSE &&
+                  IcsAngleFixed::toPos(IcsAngleFixed::DEG100_MAX + 1) == IcsAngleFixed::POS_FALSE,
+              "angles out of range");
@@ -0,0 +1,156 @@
+/**
+ *@file IcsAsyncBus.cpp
+ *@brief Asynchronous submit/complete access to one ICS bus
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <chrono>
+#include "IcsAsyncBus.h"
+
+/**
+ *@brief constructor
+ *@param[in] bus Bus to drive. Must outlive this object and must not be used directly while commands are pending.
+ **/
+IcsAsyncBus::IcsAsyncBus(IcsBaseClass &bus) : bus_default(bus)
+{
+    worker = std::thread(&IcsAsyncBus::run, this);
+}
+
+/**
+ *@brief destructor
+ *@post Commands not started yet are dropped, the worker thread is joined
+ **/
+IcsAsyncBus::~IcsAsyncBus()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    submitted_cv.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+/**
+ *@brief Queue a command for the bus
+ *@param[in] cmd Command to run
+ *@return Ticket identifying the command in the completion queue
+ **/
+unsigned long IcsAsyncBus::submit(const IcsCommand &cmd)
+{
+    unsigned long ticket;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        IcsCompletion entry;
+        entry.ticket = ticket = next_ticket++;
+        entry.cmd = cmd;
+        submit_queue.push_back(entry);
+        in_flight++;
+    }
+    submitted_cv.notify_one();
+    return ticket;
+}
+
+/**
+ *@brief Take the oldest completed command without blocking
+ *@param[out] completion Completed command
+ *@retval true A completion was returned
+ *@retval false Nothing has completed yet
+ **/
+bool IcsAsyncBus::poll(IcsCompletion &completion)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (complete_queue.empty())
+        return false;
+    completion = complete_queue.front();
+    complete_queue.pop_front();
+    return true;
+}
+
+/**
+ *@brief Take the oldest completed command, waiting for one if necessary
+ *@param[out] completion Completed command
+ *@param[in] timeout Maximum waiting time (ms), negative waits forever
+ *@retval true A completion was returned
+ *@retval false Timeout
+ **/
+bool IcsAsyncBus::wait(IcsCompletion &completion, int timeout)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto ready = [this] { return !complete_queue.empty(); };
+    if (timeout < 0)
+        completed_cv.wait(guard, ready);
+    else if (!completed_cv.wait_for(guard, std::chrono::milliseconds(timeout), ready))
+        return false;
+
+    completion = complete_queue.front();
+    complete_queue.pop_front();
+    return true;
+}
+
+/**
+ *@brief Wait until every submitted command has been run
+ *@param[in] timeout Maximum waiting time (ms), negative waits forever
+ *@retval true The bus is idle
+ *@retval false Timeout
+ *@note Completions stay in the queue and still have to be collected with poll() or wait().
+ **/
+bool IcsAsyncBus::waitIdle(int timeout)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    auto idle = [this] { return in_flight == 0; };
+    if (timeout < 0)
+    {
+        completed_cv.wait(guard, idle);
+        return true;
+    }
+    return completed_cv.wait_for(guard, std::chrono::milliseconds(timeout), idle);
+}
+
+/**
+ *@brief Number of commands submitted but not completed yet
+ *@return Pending command count
+ **/
+unsigned long IcsAsyncBus::pending()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return in_flight;
+}
+
+/**
+ *@brief Get the bus driven by this object
+ *@return Bus reference
+ **/
+IcsBaseClass &IcsAsyncBus::getBus()
+{
+    return bus_default;
+}
+
+/**
+ *@brief Worker thread: run the queued commands one after another
+ **/
+void IcsAsyncBus::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        submitted_cv.wait(guard, [this] { return stopping || !submit_queue.empty(); });
+        if (stopping)
+            return;
+
+        IcsCompletion entry = submit_queue.front();
+        submit_queue.pop_front();
+
+        // Talk to the servo without holding the lock so the caller can keep submitting
+        guard.unlock();
+        entry.result = entry.cmd.execute(bus_default);
+        guard.lock();
+
+        complete_queue.push_back(entry);
+        in_flight--;
+        completed_cv.notify_all();
+    }
+}
@@ -10,6 +10,9 @@
 #include <wiringPi.h>
 #include "IcsBaseClass.h"
 
+// Definition of the constant, so it may also be passed by reference (e.g. to std::vector::assign)
+constexpr int IcsBaseClass::ICS_FALSE;
+
 // Servo ID range /////////////////////////////////////////////////////////////////////////////////////////////
 /**
  * @brief Check if the servo ID is within range
@@ -104,6 +107,7 @@ float IcsBaseClass::posDeg(int pos)
  * @param[in] deg Angle (deg x100) (int type)
  * @return Converted position data
  * @retval -1 out of range
+ * @note Not the exact inverse of posDeg100(), IcsAngleFixed::toPos() is
  **/
 int IcsBaseClass::degPos100(int deg)
 {
@@ -127,6 +131,7 @@ int IcsBaseClass::degPos100(int deg)
  * @return Angle (deg x100) (int type)
  * @retval #ANGLE_I_FALSE Out of range in positive direction
  * @retval -#ANGLE_I_FALSE Out of range in negative direction
+ * @note Not the exact inverse of degPos100(), IcsAngleFixed::toDeg100() is
  **/
 int IcsBaseClass::posDeg100(int pos)
 {
@@ -540,6 +545,7 @@ int IcsBaseClass::getPos(unsigned char id)
  * @retval -1 out of range, communication failure
  * @date 2020/02/20 Added from Ver2.1.0
  * Please connect only one-to-one with @attention ID command. If you connect many, unintended data will be returned.
+ * @note To find the servos of a whole robot use IcsBusScan, which probes every ID on every bus in tens of ms.
  **/
 int IcsBaseClass::getID()
 {
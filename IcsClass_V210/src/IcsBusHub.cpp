@@ -0,0 +1,451 @@
+/**
+ *@file IcsBusHub.cpp
+ *@brief Drives several ICS buses concurrently, one worker thread per bus
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "IcsBusHub.h"
+#include "IcsClock.h"
+#include "IcsHardSerialClass.h"
+
+/**
+ *@brief constructor
+ **/
+IcsBusHub::IcsBusHub()
+{
+}
+
+/**
+ *@brief destructor
+ *@post All worker threads are joined and buses created by the hub are closed
+ **/
+IcsBusHub::~IcsBusHub()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    for (auto &worker : workers)
+    {
+        wake(worker.get());
+        if (worker->thread.joinable())
+            worker->thread.join();
+        close(worker->wake_fd);
+    }
+}
+
+/**
+ *@brief Add a bus created by the caller
+ *@param[in] bus Bus object. Must outlive the hub.
+ *@return Bus index
+ **/
+int IcsBusHub::addBus(IcsBaseClass &bus)
+{
+    BusWorker *worker = new BusWorker;
+    worker->bus = &bus;
+    return startWorker(worker);
+}
+
+/**
+ *@brief Open a UART bus owned by the hub
+ *@param[in] device UART device name
+ *@param[in] enpin Pin number of transmit/receive switching pin
+ *@param[in] baudrate Servo communication speed
+ *@param[in] timeout Reception timeout (ms)
+ *@return Bus index
+ **/
+int IcsBusHub::addBus(const char *device, unsigned char enpin, unsigned int baudrate, int timeout)
+{
+    BusWorker *worker = new BusWorker;
+    IcsHardSerialClass *serial = new IcsHardSerialClass(device, enpin, baudrate, timeout);
+    serial->setBusId(workers.size()); // Diagnostic events carry the hub bus index
+    worker->owned.reset(serial);
+    worker->bus = serial;
+    return startWorker(worker);
+}
+
+/**
+ *@brief Register a servo
+ *@param[in] bus Bus index returned by addBus()
+ *@param[in] id Servo ID on that bus
+ *@return Joint index, used to address the per-joint arrays of the whole-robot calls
+ *@retval -1 Unknown bus
+ **/
+int IcsBusHub::addJoint(int bus, unsigned char id)
+{
+    if (bus < 0 || bus >= (int)workers.size())
+        return -1;
+
+    IcsJoint joint;
+    joint.bus = bus;
+    joint.id = id;
+    joints.push_back(joint);
+
+    int index = (int)joints.size() - 1;
+    workers[bus]->joints.push_back(index);
+    state_table.resize(joints.size());
+    batch_times.resize(joints.size());
+    return index;
+}
+
+/**
+ *@brief Number of buses
+ *@return Bus count
+ **/
+int IcsBusHub::getBusCount() const
+{
+    return (int)workers.size();
+}
+
+/**
+ *@brief Number of registered joints
+ *@return Joint count
+ **/
+int IcsBusHub::getJointCount() const
+{
+    return (int)joints.size();
+}
+
+/**
+ *@brief Access a bus directly
+ *@param[in] bus Bus index
+ *@return Bus reference
+ *@attention Do not use it while a whole-robot call is running.
+ **/
+IcsBaseClass &IcsBusHub::getBus(int bus)
+{
+    return *workers[bus]->bus;
+}
+
+/**
+ *@brief Get the location of a joint
+ *@param[in] joint Joint index
+ *@return Bus index and servo ID
+ **/
+const IcsJoint &IcsBusHub::getJoint(int joint) const
+{
+    return joints[joint];
+}
+
+/**
+ *@brief Run the same command on every joint, all buses in parallel
+ *@param[in] type Command to run
+ *@param[in] values Per-joint values (getJointCount() entries), may be null for getters
+ *@param[out] results Per-joint return values (getJointCount() entries), may be null
+ *@retval true Every joint answered
+ *@retval false At least one joint returned #ICS_FALSE
+ **/
+bool IcsBusHub::run(IcsCommand::Type type, const unsigned int *values, int *results)
+{
+    std::vector<int> scratch;
+    if (!results)
+    {
+        scratch.resize(joints.size());
+        results = scratch.data();
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    batch_type = type;
+    batch_values = values;
+    batch_results = results;
+    busy = (int)workers.size();
+    generation++;
+    for (auto &worker : workers)
+        wake(worker.get());
+
+    done_cv.wait(guard, [this] { return busy == 0; });
+    batch_values = nullptr;
+    batch_results = nullptr;
+    guard.unlock();
+
+    publish(type, results);
+
+    bool ok = true;
+    for (size_t i = 0; i < joints.size(); i++)
+    {
+        if (results[i] == IcsBaseClass::ICS_FALSE)
+            ok = false;
+    }
+    return ok;
+}
+
+/**
+ *@brief Send a target position to every joint
+ *@param[in] pos Per-joint target positions
+ *@param[out] results Per-joint returned positions (may be null)
+ *@retval true Every joint answered
+ *@retval false At least one joint failed
+ **/
+bool IcsBusHub::setPositions(const unsigned int *pos, int *results)
+{
+    return run(IcsCommand::SET_POS, pos, results);
+}
+
+/**
+ *@brief Read the current position of every joint
+ *@param[out] pos Per-joint positions (#ICS_FALSE on failure)
+ *@retval true Every joint answered
+ *@retval false At least one joint failed
+ *@attention Valid from ICS3.6.
+ **/
+bool IcsBusHub::readPositions(int *pos)
+{
+    return run(IcsCommand::GET_POS, nullptr, pos);
+}
+
+/**
+ *@brief Queue a target position for a servo (control thread only)
+ *@param[in] bus Bus index
+ *@param[in] id Servo ID on that bus
+ *@param[in] pos Target position
+ *@retval true Queued, it is sent after the next commitTargets()
+ *@retval false Unknown bus or ring full
+ *@note Lock-free. Each bus ring has a single producer, so only one thread may push targets.
+ **/
+bool IcsBusHub::pushTarget(int bus, unsigned char id, unsigned int pos)
+{
+    if (bus < 0 || bus >= (int)workers.size())
+        return false;
+
+    IcsJointTarget target;
+    target.id = id;
+    target.pos = pos;
+    return workers[bus]->targets.push(target);
+}
+
+/**
+ *@brief Wake the bus workers so they send the queued targets
+ *@note One eventfd write per bus, no lock is taken.
+ **/
+void IcsBusHub::commitTargets()
+{
+    for (auto &worker : workers)
+    {
+        if (!worker->targets.empty())
+            wake(worker.get());
+    }
+}
+
+/**
+ *@brief Take the oldest reply of a bus (control thread only)
+ *@param[in] bus Bus index
+ *@param[out] feedback Reply to a pushed target
+ *@retval true A reply was returned
+ *@retval false Unknown bus or nothing received yet
+ **/
+bool IcsBusHub::popFeedback(int bus, IcsJointFeedback &feedback)
+{
+    if (bus < 0 || bus >= (int)workers.size())
+        return false;
+    if (!workers[bus]->feedback.pop(feedback))
+        return false;
+
+    if (feedback.ok)
+    {
+        for (int j : workers[bus]->joints)
+        {
+            if (joints[j].id == feedback.id)
+            {
+                state_table.beginWrite();
+                state_table.setPos(j, feedback.pos, feedback.timestampNs);
+                state_table.endWrite();
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ *@brief Number of replies lost because the control thread did not collect them in time
+ *@param[in] bus Bus index
+ *@return Dropped reply count
+ **/
+unsigned long IcsBusHub::getFeedbackDropped(int bus) const
+{
+    return workers[bus]->feedback_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ *@brief Apply real-time settings to the worker thread of a bus
+ *@param[in] bus Bus index
+ *@param[in] policy Scheduling class, CPU affinity, memory locking, stack prefault and timer slack
+ *@return What actually took effect on the worker thread
+ *@note Blocks until the worker has applied the policy. Call it between whole-robot calls.
+ **/
+IcsRtReport IcsBusHub::setRtPolicy(int bus, const IcsRtPolicy &policy)
+{
+    return runOnWorker(bus, &policy);
+}
+
+/**
+ *@brief Report which settings of the last policy are still in effect on the worker thread of a bus
+ *@param[in] bus Bus index
+ *@return Self-check read back on the worker thread
+ **/
+IcsRtReport IcsBusHub::checkRtPolicy(int bus)
+{
+    return runOnWorker(bus, nullptr);
+}
+
+/**
+ *@brief Have a worker apply (or only check) its real-time policy and wait for the report
+ *@param[in] bus Bus index
+ *@param[in] policy New policy to apply, null to check the current one
+ *@return Report produced on the worker thread
+ **/
+IcsRtReport IcsBusHub::runOnWorker(int bus, const IcsRtPolicy *policy)
+{
+    BusWorker *worker = workers[bus].get();
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (policy)
+        worker->rt_policy = *policy;
+    worker->rt_check_only = (policy == nullptr);
+    worker->rt_pending = true;
+    wake(worker);
+    done_cv.wait(guard, [worker] { return !worker->rt_pending; });
+    return worker->rt_report;
+}
+
+/**
+ *@brief Get the published joint state
+ *@return Table updated after every whole-robot call and every collected streaming reply
+ *@note Readers may call read() on it from any thread at any time.
+ **/
+const IcsJointStateTable &IcsBusHub::getStateTable() const
+{
+    return state_table;
+}
+
+/**
+ *@brief Publish the successful replies of a batch as one snapshot
+ *@param[in] type Command of the batch
+ *@param[in] results Per-joint results
+ **/
+void IcsBusHub::publish(IcsCommand::Type type, const int *results)
+{
+    if (type != IcsCommand::SET_POS && type != IcsCommand::SET_FREE && type != IcsCommand::GET_POS &&
+        type != IcsCommand::GET_CUR && type != IcsCommand::GET_TMP)
+        return;
+
+    state_table.beginWrite();
+    for (size_t j = 0; j < joints.size(); j++)
+    {
+        if (results[j] == IcsBaseClass::ICS_FALSE)
+            continue; // Keep the last known value
+        if (type == IcsCommand::GET_CUR)
+            state_table.setCurrent(j, results[j], batch_times[j]);
+        else if (type == IcsCommand::GET_TMP)
+            state_table.setTemperature(j, results[j], batch_times[j]);
+        else
+            state_table.setPos(j, results[j], batch_times[j]);
+    }
+    state_table.endWrite();
+}
+
+/**
+ *@brief Wake a worker thread
+ *@param[in] worker Worker to wake
+ **/
+void IcsBusHub::wake(BusWorker *worker)
+{
+    uint64_t one = 1;
+    ssize_t ret = write(worker->wake_fd, &one, sizeof one); // Only fails if the counter overflows, which cannot happen here
+    (void)ret;
+}
+
+/**
+ *@brief Register a worker and start its thread
+ *@param[in] worker New worker (ownership is taken)
+ *@return Bus index
+ **/
+int IcsBusHub::startWorker(BusWorker *worker)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        worker->generation = generation;
+    }
+    worker->wake_fd = eventfd(0, EFD_CLOEXEC);
+    workers.push_back(std::unique_ptr<BusWorker>(worker));
+    worker->thread = std::thread(&IcsBusHub::workerLoop, this, worker);
+    return (int)workers.size() - 1;
+}
+
+/**
+ *@brief Worker thread: send streamed targets and run this bus's share of every batch
+ *@param[in] worker Worker owning this thread
+ **/
+void IcsBusHub::workerLoop(BusWorker *worker)
+{
+    while (true)
+    {
+        // Streamed targets first, they are the latency critical path
+        IcsJointTarget target;
+        while (worker->targets.pop(target))
+        {
+            IcsJointFeedback reply;
+            reply.id = target.id;
+            reply.pos = worker->bus->setPos(target.id, target.pos);
+            reply.ok = (reply.pos != IcsBaseClass::ICS_FALSE);
+            reply.timestampNs = IcsClock::nowNs();
+
+            if (!worker->feedback.push(reply))
+                worker->feedback_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        if (stopping)
+            return;
+
+        if (worker->rt_pending)
+        {
+            IcsRtPolicy policy = worker->rt_policy;
+            bool checkOnly = worker->rt_check_only;
+            guard.unlock();
+            IcsRtReport report = checkOnly ? policy.check() : policy.apply();
+            guard.lock();
+            worker->rt_report = report;
+            worker->rt_pending = false;
+            done_cv.notify_all();
+            continue;
+        }
+
+        if (generation != worker->generation)
+        {
+            worker->generation = generation;
+
+            IcsCommand cmd;
+            cmd.type = batch_type;
+            const unsigned int *values = batch_values;
+            int *results = batch_results;
+            guard.unlock();
+
+            // Each worker only touches the result slots of its own joints
+            for (int j : worker->joints)
+            {
+                cmd.id = joints[j].id;
+                cmd.value = values ? values[j] : 0;
+                results[j] = cmd.execute(*worker->bus);
+                batch_times[j] = IcsClock::nowNs();
+            }
+
+            guard.lock();
+            if (--busy == 0)
+                done_cv.notify_all();
+            continue;
+        }
+        guard.unlock();
+
+        // Nothing to do: sleep until pushTarget/commitTargets, run() or the destructor wakes us
+        uint64_t count;
+        if (read(worker->wake_fd, &count, sizeof count) < 0 && errno != EINTR)
+            return;
+    }
+}
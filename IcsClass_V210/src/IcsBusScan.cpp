@@ -0,0 +1,267 @@
+/**
+ *@file IcsBusScan.cpp
+ *@brief Servo discovery: which IDs answer on which bus, probed on all buses at once
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <poll.h>
+#include <thread>
+#include "IcsBusHub.h"
+#include "IcsBusScan.h"
+#include "IcsClock.h"
+#include "IcsHardSerialClass.h"
+
+constexpr int IcsBusScan::ID_COUNT;
+
+namespace
+{
+  // Sleep in the kernel until the port has data or the deadline passes
+  bool waitReadable(int fd, long long deadlineNs)
+  {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    struct timespec ts = IcsClock::toTimespec(deadlineNs - IcsClock::nowNs());
+    return ppoll(&pfd, 1, &ts, NULL) > 0 && (pfd.revents & POLLIN);
+  }
+
+  // Temperature read: CMD, SC -> CMD echo, SC echo, value. bytesRead tells a wrong reply from a short one.
+  bool probe(IcsHardSerialClass &serial, int id, unsigned int timeoutUs, unsigned char *rxCmd, int &bytesRead)
+  {
+    const unsigned char rxLen = 3;
+    unsigned char txCmd[2] = {(unsigned char)(0xA0 + id), 0x04};
+    bytesRead = 0;
+    if (!serial.beginTransaction(txCmd, sizeof txCmd, rxLen))
+      return false;
+
+    long long deadline = IcsClock::deadlineNs(timeoutUs * IcsClock::NS_PER_US + serial.getTimingModel().wireNs(rxLen));
+    while (bytesRead < rxLen && waitReadable(serial.getFd(), deadline))
+      bytesRead = serial.readAvailable(rxCmd, rxLen, bytesRead);
+    return serial.finishTransaction(txCmd, sizeof txCmd, rxCmd, rxLen, bytesRead);
+  }
+}
+
+/**
+ *@brief constructor, nothing found yet
+ **/
+IcsScanBus::IcsScanBus()
+{
+    for (int id = 0; id < 32; id++)
+        temperature[id] = IcsBaseClass::ICS_FALSE;
+}
+
+/**
+ *@brief Number of IDs that answered, over all buses
+ *@return Servo count (a shared ID counts once)
+ **/
+int IcsScanResult::getServoCount() const
+{
+    int count = 0;
+    for (size_t b = 0; b < buses.size(); b++)
+        count += (int)buses[b].ids.size();
+    return count;
+}
+
+/**
+ *@brief Number of IDs answered by more than one servo of the same bus
+ *@return Shared ID count, 0 for a usable map
+ *@note The same ID on different buses is fine, every bus is addressed on its own.
+ **/
+int IcsScanResult::getDuplicateCount() const
+{
+    int count = 0;
+    for (size_t b = 0; b < buses.size(); b++)
+        for (int id = 0; id < 32; id++)
+            count += (buses[b].duplicates >> id) & 1;
+    return count;
+}
+
+/**
+ *@brief Find the bus of a servo
+ *@param[in] id Servo ID
+ *@return Index of the first bus on which the ID answered
+ *@retval -1 Not found
+ **/
+int IcsScanResult::findBus(unsigned char id) const
+{
+    for (size_t b = 0; b < buses.size(); b++)
+        if (id < 32 && ((buses[b].present >> id) & 1))
+            return (int)b;
+    return -1;
+}
+
+/**
+ *@brief constructor, probes every ID with the default timeouts
+ **/
+IcsBusScan::IcsBusScan()
+{
+}
+
+/**
+ *@brief Set how long an ID may take to answer
+ *@param[in] timeoutUs Wait after the command has left, on top of the reply wire time (us)
+ *@note Every absent ID costs this much, so it sets the scan time. The servo answers within a few hundred us unless its
+ *      response delay has been raised.
+ **/
+void IcsBusScan::setProbeTimeout(unsigned int timeoutUs)
+{
+    probe_timeout_us = timeoutUs;
+}
+
+/**
+ *@brief Get the probe timeout
+ *@return Timeout (us)
+ **/
+unsigned int IcsBusScan::getProbeTimeout() const
+{
+    return probe_timeout_us;
+}
+
+/**
+ *@brief Set how long to listen for a second reply after a complete one
+ *@param[in] windowUs Wait (us)
+ **/
+void IcsBusScan::setDuplicateWindow(unsigned int windowUs)
+{
+    duplicate_window_us = windowUs;
+}
+
+/**
+ *@brief Get the duplicate window
+ *@return Wait (us)
+ **/
+unsigned int IcsBusScan::getDuplicateWindow() const
+{
+    return duplicate_window_us;
+}
+
+/**
+ *@brief Choose the IDs to probe
+ *@param[in] mask Bit id set for every ID to probe (default all 32)
+ **/
+void IcsBusScan::setIdMask(unsigned int mask)
+{
+    id_mask = mask;
+}
+
+/**
+ *@brief Get the IDs to probe
+ *@return Bit id set for every ID probed
+ **/
+unsigned int IcsBusScan::getIdMask() const
+{
+    return id_mask;
+}
+
+/**
+ *@brief Probe all buses of a hub, one thread per bus
+ *@param[in] &hub Hub with its buses added (joints are not needed)
+ *@param[out] &result Map indexed like the hub buses
+ *@return false if an ID is shared by several servos of one bus
+ *@attention Do not call while the hub runs whole-robot calls, the buses are used directly.
+ **/
+bool IcsBusScan::scan(IcsBusHub &hub, IcsScanResult &result) const
+{
+    std::vector<IcsBaseClass *> buses;
+    for (int b = 0; b < hub.getBusCount(); b++)
+        buses.push_back(&hub.getBus(b));
+    return scan(buses, result);
+}
+
+/**
+ *@brief Probe several buses, one thread per bus
+ *@param[in] &buses Buses to probe
+ *@param[out] &result Map indexed like buses
+ *@return false if an ID is shared by several servos of one bus
+ **/
+bool IcsBusScan::scan(const std::vector<IcsBaseClass *> &buses, IcsScanResult &result) const
+{
+    long long start = IcsClock::nowNs();
+    result.buses.assign(buses.size(), IcsScanBus());
+
+    std::vector<std::thread> threads;
+    for (size_t b = 0; b < buses.size(); b++)
+        threads.emplace_back([this, &buses, &result, b]()
+                             { scanBus(*buses[b], result.buses[b]); });
+    for (size_t b = 0; b < threads.size(); b++)
+        threads[b].join();
+
+    result.elapsedNs = IcsClock::nowNs() - start;
+    return result.getDuplicateCount() == 0;
+}
+
+/**
+ *@brief Probe the IDs of one bus in turn, on the calling thread
+ *@param[in] &bus Bus to probe
+ *@param[out] &result What the bus answered
+ *@note UART buses use the split transaction so the probe timeout is in us and the bytes after a reply can be seen.
+ *      Other buses fall back to getTmp() with their own timeout and only see corrupted replies.
+ **/
+void IcsBusScan::scanBus(IcsBaseClass &bus, IcsScanBus &result) const
+{
+    long long start = IcsClock::nowNs();
+    result = IcsScanBus();
+    IcsHardSerialClass *serial = dynamic_cast<IcsHardSerialClass *>(&bus);
+
+    for (int id = 0; id < ID_COUNT; id++)
+    {
+        if (!((id_mask >> id) & 1))
+            continue;
+        result.probes++;
+
+        if (!serial)
+        {
+            int tmp = bus.getTmp(id);
+            if (tmp != IcsBaseClass::ICS_FALSE)
+            {
+                result.present |= 1u << id;
+                result.temperature[id] = tmp;
+            }
+            continue;
+        }
+
+        unsigned char rxCmd[3];
+        int bytesRead;
+        bool ok = probe(*serial, id, probe_timeout_us, rxCmd, bytesRead);
+        if (!ok && bytesRead == (int)sizeof rxCmd)
+        {
+            // Complete but wrong: colliding replies, or noise on the reply of a single servo. Ask once more before
+            // calling it a shared ID.
+            result.probes++;
+            ok = probe(*serial, id, probe_timeout_us, rxCmd, bytesRead);
+            if (!ok && bytesRead == (int)sizeof rxCmd)
+            {
+                result.present |= 1u << id;
+                result.duplicates |= 1u << id;
+                continue;
+            }
+        }
+
+        if (ok)
+        {
+            result.present |= 1u << id;
+            result.temperature[id] = rxCmd[2];
+
+            // A second servo with this ID answers at the same time: its bytes follow (or garble) the first reply.
+            // Drain until the line stays quiet, so they are not taken for the reply of the next ID.
+            while (waitReadable(serial->getFd(), IcsClock::deadlineNs(duplicate_window_us * IcsClock::NS_PER_US)))
+            {
+                result.duplicates |= 1u << id;
+                serial->resync();
+            }
+        }
+        else if (bytesRead > 0)
+        {
+            result.partial |= 1u << id;
+        }
+    }
+
+    for (int id = 0; id < ID_COUNT; id++)
+        if ((result.present >> id) & 1)
+            result.ids.push_back(id);
+    result.elapsedNs = IcsClock::nowNs() - start;
+}
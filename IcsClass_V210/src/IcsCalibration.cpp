@@ -0,0 +1,286 @@
+/**
+ *@file IcsCalibration.cpp
+ *@brief Per-joint calibration between joint angles (rad) and servo positions
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include "IcsBaseClass.h"
+#include "IcsCalibration.h"
+
+constexpr float IcsCalibration::POS_PER_RAD;
+
+namespace
+{
+  const float DEG_TO_RAD = 3.14159265f / 180.0f;
+}
+
+/**
+ *@brief constructor
+ *@param[in] joints Number of joints, all start with the identity calibration
+ **/
+IcsCalibration::IcsCalibration(int joints)
+{
+    resize(joints);
+}
+
+/**
+ *@brief Change the number of joints, new joints get the identity calibration
+ *@param[in] joints Number of joints
+ **/
+void IcsCalibration::resize(int joints)
+{
+    int old = getJointCount();
+    joints_default.resize(joints);
+    scale.resize(joints);
+    inv_scale.resize(joints);
+    center.resize(joints);
+    low.resize(joints);
+    high.resize(joints);
+    for (int j = old; j < joints; j++)
+        derive(j);
+}
+
+/**
+ *@brief Get the number of joints
+ *@return Number of joints
+ **/
+int IcsCalibration::getJointCount() const
+{
+    return (int)joints_default.size();
+}
+
+/**
+ *@brief Set the calibration of one joint
+ *@param[in] joint Joint index
+ *@param[in] &calibration Calibration
+ *@return false if the joint does not exist or the calibration is invalid (sign not ±1, gear 0, limits swapped)
+ **/
+bool IcsCalibration::setJoint(int joint, const IcsJointCalibration &calibration)
+{
+    if (joint < 0 || joint >= getJointCount())
+    {
+        std::cerr << "Calibration: no joint " << joint << std::endl;
+        return false;
+    }
+    if ((calibration.sign != 1 && calibration.sign != -1) || calibration.gear == 0.0f || !(calibration.minRad <= calibration.maxRad))
+    {
+        std::cerr << "Calibration: invalid values for joint " << joint << std::endl;
+        return false;
+    }
+    joints_default[joint] = calibration;
+    derive(joint);
+    return true;
+}
+
+/**
+ *@brief Get the calibration of one joint
+ *@param[in] joint Joint index (must exist)
+ *@return Calibration
+ **/
+const IcsJointCalibration &IcsCalibration::getJoint(int joint) const
+{
+    return joints_default[joint];
+}
+
+/**
+ *@brief Calibrate a joint as the mirror image of another, e.g. the right leg from the left leg
+ *@param[in] joint Joint index to set
+ *@param[in] from Joint index to copy
+ *@param[in] offset Servo angle of the mirrored joint at joint angle 0 (rad), the zero offset is not mirrored
+ *@return false if either joint does not exist
+ *@note Gear and soft limits are copied, the sign is flipped: the same joint angle turns the mirrored servo the other way.
+ **/
+bool IcsCalibration::mirror(int joint, int from, float offset)
+{
+    if (from < 0 || from >= getJointCount())
+    {
+        std::cerr << "Calibration: no joint " << from << std::endl;
+        return false;
+    }
+    IcsJointCalibration calibration = joints_default[from];
+    calibration.sign = -calibration.sign;
+    calibration.offset = offset;
+    return setJoint(joint, calibration);
+}
+
+/**
+ *@brief Load the calibration from a text file
+ *@param[in] *path File name
+ *@return false if the file cannot be read or a line is invalid (the lines before it stay applied)
+ *@note One joint per line, angles in degrees, '#' starts a comment. The table grows to the highest joint index.
+ *@note   joint  offset  sign  gear  min  max        e.g.  0   2.5  1  1.0  -90  90
+ *@note   joint  mirror  from  [offset]              e.g.  6   mirror  0  -1.5
+ **/
+bool IcsCalibration::load(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Calibration: unable to open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(file, line))
+    {
+        lineNo++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream in(line);
+        int joint;
+        if (!(in >> joint))
+        {
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue; // empty or comment
+            std::cerr << "Calibration: " << path << ":" << lineNo << ": joint index expected" << std::endl;
+            return false;
+        }
+        if (joint < 0)
+        {
+            std::cerr << "Calibration: " << path << ":" << lineNo << ": negative joint index" << std::endl;
+            return false;
+        }
+        if (joint >= getJointCount())
+            resize(joint + 1);
+
+        std::string word;
+        in >> word;
+        bool ok;
+        if (word == "mirror")
+        {
+            int from;
+            float offset = 0.0f;
+            ok = (bool)(in >> from);
+            if (ok && !(in >> offset))
+                offset = 0.0f;
+            ok = ok && mirror(joint, from, offset * DEG_TO_RAD);
+        }
+        else
+        {
+            std::istringstream values(line);
+            IcsJointCalibration calibration;
+            float offset, minDeg, maxDeg;
+            ok = (bool)(values >> joint >> offset >> calibration.sign >> calibration.gear >> minDeg >> maxDeg);
+            if (ok)
+            {
+                calibration.offset = offset * DEG_TO_RAD;
+                calibration.minRad = minDeg * DEG_TO_RAD;
+                calibration.maxRad = maxDeg * DEG_TO_RAD;
+                ok = setJoint(joint, calibration);
+            }
+        }
+        if (!ok)
+        {
+            std::cerr << "Calibration: " << path << ":" << lineNo << ": invalid line" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ *@brief Map joint angles to clamped servo positions
+ *@param[in] *rad Joint angles (rad), one per joint
+ *@param[out] *pos Positions for IcsBusHub::setPositions(), clamped to the soft limits and the servo range
+ *@param[out] *mask Optional clamped joints, bit (j % 32) of mask[j / 32]. (joints + 31) / 32 words.
+ *@return Number of clamped joints
+ *@note NaN is clamped to the lower limit.
+ **/
+int IcsCalibration::toPositions(const float *rad, unsigned int *pos, unsigned int *mask) const
+{
+    const int joints = getJointCount();
+    const float *s = scale.data();
+    const float *c = center.data();
+    const float *lo = low.data();
+    const float *hi = high.data();
+
+    // Branch-free (selects only) so the loop vectorises
+    int clamped = 0;
+    for (int j = 0; j < joints; j++)
+    {
+        float v = s[j] * rad[j] + c[j];
+        clamped += 1 - ((v >= lo[j]) & (v <= hi[j]));
+        v = (v >= lo[j]) ? v : lo[j];
+        v = (v <= hi[j]) ? v : hi[j];
+        pos[j] = (int)(v + 0.5f);
+    }
+
+    if (mask)
+    {
+        for (int w = 0; w < (joints + 31) / 32; w++)
+            mask[w] = 0;
+        for (int j = 0; clamped && j < joints; j++)
+        {
+            float v = s[j] * rad[j] + c[j];
+            if (!(v >= lo[j] && v <= hi[j]))
+                mask[j / 32] |= 1u << (j % 32);
+        }
+    }
+    return clamped;
+}
+
+/**
+ *@brief Map servo positions back to joint angles
+ *@param[in] *pos Positions, e.g. the replies of IcsBusHub::setPositions()/readPositions()
+ *@param[out] *rad Joint angles (rad), NaN for replies that are not a position (#ICS_FALSE or out of range)
+ *@param[out] *mask Optional invalid joints, bit (j % 32) of mask[j / 32]. (joints + 31) / 32 words.
+ *@return Number of invalid joints
+ **/
+int IcsCalibration::toRadians(const int *pos, float *rad, unsigned int *mask) const
+{
+    const int joints = getJointCount();
+    const float *is = inv_scale.data();
+    const float *c = center.data();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    int invalid = 0;
+    for (int j = 0; j < joints; j++)
+    {
+        float p = (float)pos[j]; // compared as float so the loop vectorises, exact in the position range
+        int ok = (p >= (float)IcsBaseClass::MIN_POS) & (p <= (float)IcsBaseClass::MAX_POS);
+        invalid += 1 - ok;
+        p = ok ? p : nan;
+        rad[j] = (p - c[j]) * is[j];
+    }
+
+    if (mask)
+    {
+        for (int w = 0; w < (joints + 31) / 32; w++)
+            mask[w] = 0;
+        for (int j = 0; invalid && j < joints; j++)
+            if (pos[j] < IcsBaseClass::MIN_POS || pos[j] > IcsBaseClass::MAX_POS)
+                mask[j / 32] |= 1u << (j % 32);
+    }
+    return invalid;
+}
+
+/**
+ *@brief Recompute the mapping coefficients of one joint
+ *@param[in] joint Joint index
+ **/
+void IcsCalibration::derive(int joint)
+{
+    const IcsJointCalibration &cal = joints_default[joint];
+    scale[joint] = POS_PER_RAD * cal.sign * cal.gear;
+    inv_scale[joint] = 1.0f / scale[joint];
+    center[joint] = 7500.0f + POS_PER_RAD * cal.offset;
+
+    float a = scale[joint] * cal.minRad + center[joint];
+    float b = scale[joint] * cal.maxRad + center[joint];
+    low[joint] = std::fmax(std::fmin(a, b), (float)IcsBaseClass::MIN_POS);
+    high[joint] = std::fmin(std::fmax(a, b), (float)IcsBaseClass::MAX_POS);
+    if (low[joint] > high[joint])
+    {
+        std::cerr << "Calibration: soft limits of joint " << joint << " are outside the servo range" << std::endl;
+        high[joint] = low[joint];
+    }
+}
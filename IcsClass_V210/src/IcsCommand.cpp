@@ -0,0 +1,148 @@
+/**
+ *@file IcsCommand.cpp
+ *@brief Servo command description shared by the asynchronous bus layers
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsCommand.h"
+
+/**
+ *@brief Run the command on a bus (blocking)
+ *@param[in,out] bus Bus the servo is connected to
+ *@return Return value of the matching IcsBaseClass function
+ *@retval -1 out of range, communication failure
+ **/
+int IcsCommand::execute(IcsBaseClass &bus) const
+{
+    switch (type)
+    {
+    case SET_POS:
+        return bus.setPos(id, value);
+    case SET_FREE:
+        return bus.setFree(id);
+    case SET_STRC:
+        return bus.setStrc(id, value);
+    case SET_SPD:
+        return bus.setSpd(id, value);
+    case SET_CUR:
+        return bus.setCur(id, value);
+    case SET_TMP:
+        return bus.setTmp(id, value);
+    case GET_STRC:
+        return bus.getStrc(id);
+    case GET_SPD:
+        return bus.getSpd(id);
+    case GET_CUR:
+        return bus.getCur(id);
+    case GET_TMP:
+        return bus.getTmp(id);
+    case GET_POS:
+        return bus.getPos(id);
+    case GET_ID:
+        return bus.getID();
+    }
+    return IcsBaseClass::ICS_FALSE;
+}
+
+/**
+ *@brief Build the command frame, with the same range checks as the IcsBaseClass functions
+ *@param[out] *txBuf Command frame (at least #MAX_TX_LEN bytes)
+ *@param[out] txLen Number of bytes to send
+ *@param[out] rxLen Number of bytes of the reply
+ *@retval true Frame built
+ *@retval false ID or value out of range
+ **/
+bool IcsCommand::encode(unsigned char *txBuf, unsigned char &txLen, unsigned char &rxLen) const
+{
+    if (id > IcsBaseClass::MAX_ID)
+    {
+        return false;
+    }
+
+    unsigned char sc = 0; // Sub command of parameter read/write
+    unsigned int maxValue = IcsBaseClass::MAX_127;
+    switch (type)
+    {
+    case SET_POS:
+        if (value > (unsigned int)IcsBaseClass::MAX_POS || value < (unsigned int)IcsBaseClass::MIN_POS)
+            return false;
+        txBuf[0] = 0x80 + id;               // CMD
+        txBuf[1] = ((value >> 7) & 0x007F); // POS_H
+        txBuf[2] = (value & 0x007F);        // POS_L
+        txLen = 3;
+        rxLen = 3;
+        return true;
+    case SET_FREE:
+        txBuf[0] = 0x80 + id; // CMD
+        txBuf[1] = 0;
+        txBuf[2] = 0;
+        txLen = 3;
+        rxLen = 3;
+        return true;
+    case SET_STRC:
+        sc = 0x01;
+        break;
+    case SET_SPD:
+        sc = 0x02;
+        break;
+    case SET_CUR:
+        sc = 0x03;
+        maxValue = IcsBaseClass::MAX_63;
+        break;
+    case SET_TMP:
+        sc = 0x04;
+        break;
+    case GET_STRC:
+    case GET_SPD:
+    case GET_CUR:
+    case GET_TMP:
+    case GET_POS:
+        txBuf[0] = 0xA0 + id;                                        // CMD
+        txBuf[1] = (type == GET_POS) ? 0x05 : (type - GET_STRC + 1); // SC: stretch 1, speed 2, current 3, temperature 4
+        txLen = 2;
+        rxLen = (type == GET_POS) ? 4 : 3;
+        return true;
+    case GET_ID:
+        txBuf[0] = 0xFF; // CMD
+        txBuf[1] = 0;    // ID loading
+        txBuf[2] = 0;    // ID loading
+        txBuf[3] = 0;    // ID loading
+        txLen = 4;
+        rxLen = 1;
+        return true;
+    }
+
+    // Parameter write
+    if (value > maxValue || value < (unsigned int)IcsBaseClass::MIN_1)
+        return false;
+    txBuf[0] = 0xC0 + id; // CMD
+    txBuf[1] = sc;        // SC
+    txBuf[2] = value;     // Parameter
+    txLen = 3;
+    rxLen = 3;
+    return true;
+}
+
+/**
+ *@brief Extract the return value from a complete reply frame
+ *@param[in] *rxBuf Reply frame of the length given by encode()
+ *@return Same value the matching IcsBaseClass function would return
+ **/
+int IcsCommand::decode(const unsigned char *rxBuf) const
+{
+    switch (type)
+    {
+    case SET_POS:
+    case SET_FREE:
+        return ((rxBuf[1] << 7) & 0x3F80) + (rxBuf[2] & 0x007F);
+    case GET_POS:
+        return ((rxBuf[2] << 7) & 0x3F80) + (rxBuf[3] & 0x007F);
+    case GET_ID:
+        return 0x1F & rxBuf[0]; // If you mask the data, it becomes an id.
+    default:
+        return rxBuf[2];
+    }
+}
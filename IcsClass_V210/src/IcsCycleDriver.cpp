@@ -0,0 +1,147 @@
+/**
+ *@file IcsCycleDriver.cpp
+ *@brief Fixed-period control loop on top of IcsBusHub with deadline-miss accounting
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cerrno>
+#include "IcsClock.h"
+#include "IcsCycleDriver.h"
+
+/**
+ *@brief Sleep until an absolute CLOCK_MONOTONIC time
+ *@param[in] deadlineNs Wake-up time (ns)
+ **/
+static void sleepUntil(long long deadlineNs)
+{
+    struct timespec ts = IcsClock::toTimespec(deadlineNs);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+/**
+ *@brief constructor
+ *@param[in] hub Buses and joints to drive. Must outlive the driver.
+ *@param[in] periodNs Cycle period (ns), e.g. 5000000 for 200 Hz
+ **/
+IcsCycleDriver::IcsCycleDriver(IcsBusHub &hub, long long periodNs) : hub_default(hub), period_default(periodNs)
+{
+}
+
+/**
+ *@brief Set the control law
+ *@param[in] callback Function called once per cycle
+ **/
+void IcsCycleDriver::setCallback(Callback callback)
+{
+    callback_default = callback;
+}
+
+/**
+ *@brief Get the cycle period
+ *@return Period (ns)
+ **/
+long long IcsCycleDriver::getPeriodNs() const
+{
+    return period_default;
+}
+
+/**
+ *@brief Run the loop on the calling thread
+ *@param[in] cycles Number of cycles to run, 0 runs until stop()
+ *@retval true The requested cycles ran (or stop() was called)
+ *@retval false No callback or no joints
+ *@note The first cycle starts one period after the call. Targets start at the current positions (or 7500 for
+ *      joints that do not answer getPos), so the robot does not jump before the callback takes over.
+ *@note After a miss the schedule is not compressed: periods that already passed are skipped and counted.
+ **/
+bool IcsCycleDriver::run(unsigned long cycles)
+{
+    int joints = hub_default.getJointCount();
+    if (!callback_default || joints == 0)
+        return false;
+
+    feedback.assign(joints, IcsBaseClass::ICS_FALSE);
+    targets.assign(joints, 7500);
+    hub_default.readPositions(feedback.data());
+    for (int j = 0; j < joints; j++)
+    {
+        if (feedback[j] != IcsBaseClass::ICS_FALSE)
+            targets[j] = feedback[j];
+    }
+
+    stop_requested.store(false);
+    long long next = IcsClock::nowNs() + period_default;
+    for (unsigned long cycle = 0; (cycles == 0 || cycle < cycles) && !stop_requested.load(); cycle++)
+    {
+        sleepUntil(next);
+        long long start = IcsClock::nowNs();
+
+        callback_default(cycle, feedback.data(), targets.data(), joints);
+        hub_default.setPositions(targets.data(), feedback.data());
+
+        long long end = IcsClock::nowNs();
+        record(start - next, end - start);
+
+        // Next period; when it already passed, count the miss and drop the periods we cannot catch up on
+        next += period_default;
+        if (end > next)
+        {
+            stats_default.misses++;
+            long long behind = (end - next) / period_default + 1;
+            stats_default.skipped += behind;
+            next += behind * period_default;
+        }
+    }
+    return true;
+}
+
+/**
+ *@brief Ask run() to return after the current cycle (any thread, or from the callback)
+ **/
+void IcsCycleDriver::stop()
+{
+    stop_requested.store(true);
+}
+
+/**
+ *@brief Get the timing statistics
+ *@return Statistics accumulated since construction or the last resetStats()
+ *@attention Read it from the thread calling run(), or after run() returned.
+ **/
+const IcsCycleStats &IcsCycleDriver::getStats() const
+{
+    return stats_default;
+}
+
+/**
+ *@brief Clear the timing statistics
+ **/
+void IcsCycleDriver::resetStats()
+{
+    stats_default = IcsCycleStats();
+}
+
+/**
+ *@brief Add one cycle to the statistics
+ *@param[in] jitterNs Wake-up delay after the scheduled start
+ *@param[in] execNs Cycle execution time
+ **/
+void IcsCycleDriver::record(long long jitterNs, long long execNs)
+{
+    if (stats_default.cycles == 0 || jitterNs < stats_default.jitterMinNs)
+        stats_default.jitterMinNs = jitterNs;
+    if (stats_default.cycles == 0 || jitterNs > stats_default.jitterMaxNs)
+        stats_default.jitterMaxNs = jitterNs;
+    if (stats_default.cycles == 0 || execNs < stats_default.execMinNs)
+        stats_default.execMinNs = execNs;
+    if (stats_default.cycles == 0 || execNs > stats_default.execMaxNs)
+        stats_default.execMaxNs = execNs;
+    stats_default.jitterSumNs += jitterNs;
+    stats_default.execSumNs += execNs;
+    stats_default.cycles++;
+}
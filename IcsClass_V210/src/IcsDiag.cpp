@@ -0,0 +1,167 @@
+/**
+ *@file IcsDiag.cpp
+ *@brief Background consumer of the bus diagnostic event rings
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "IcsDiag.h"
+#include "IcsHardSerialClass.h"
+
+/**
+ *@brief constructor
+ **/
+IcsDiagLogger::IcsDiagLogger()
+{
+}
+
+/**
+ *@brief destructor
+ *@post The consumer thread is stopped and the remaining events are drained
+ **/
+IcsDiagLogger::~IcsDiagLogger()
+{
+    stop();
+}
+
+/**
+ *@brief Drain the diagnostic ring of a bus
+ *@param[in] &bus Bus to watch, must outlive the logger
+ *@attention Add all buses before start().
+ **/
+void IcsDiagLogger::addBus(IcsHardSerialClass &bus)
+{
+    buses.push_back(&bus);
+}
+
+/**
+ *@brief Forward events to a function instead of printing them
+ *@param[in] &eventSink Called from the consumer thread for each event (empty: print to stderr)
+ *@attention Set before start().
+ **/
+void IcsDiagLogger::setSink(const Sink &eventSink)
+{
+    sink = eventSink;
+}
+
+/**
+ *@brief Pass every event waiting in the rings to the sink
+ *@return Number of events drained
+ *@note Called by the consumer thread. Without start() it can be called periodically from a non-RT thread.
+ **/
+int IcsDiagLogger::drain()
+{
+    IcsDiagEvent event;
+    unsigned long dropped = 0;
+    int count = 0;
+
+    for (size_t i = 0; i < buses.size(); i++)
+    {
+        IcsDiagRing &ring = buses[i]->getDiagRing();
+        while (ring.pop(event))
+        {
+            if (sink)
+                sink(event);
+            else
+                print(event);
+            count++;
+        }
+        dropped += buses[i]->getDiagDropped();
+    }
+
+    if (dropped > reported_dropped)
+    {
+        fprintf(stderr, "ics diag: %lu events dropped\n", dropped - reported_dropped);
+        reported_dropped = dropped;
+    }
+    return count;
+}
+
+/**
+ *@brief Start draining in a background thread
+ *@param[in] periodMs Time between two drains (ms)
+ **/
+void IcsDiagLogger::start(unsigned int periodMs)
+{
+    if (thread.joinable())
+        return;
+    stopping = false;
+    thread = std::thread(&IcsDiagLogger::consumerLoop, this, periodMs);
+}
+
+/**
+ *@brief Stop the background thread, draining what is left
+ **/
+void IcsDiagLogger::stop()
+{
+    if (!thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    thread.join();
+}
+
+/**
+ *@brief Readable name of an event code
+ *@param[in] code Event code
+ *@return Constant string
+ **/
+const char *IcsDiagLogger::codeName(IcsDiagEvent::Code code)
+{
+    switch (code)
+    {
+    case IcsDiagEvent::DIAG_WRITE_FAILED:
+        return "write failed";
+    case IcsDiagEvent::DIAG_READ_FAILED:
+        return "read failed";
+    case IcsDiagEvent::DIAG_TIMEOUT:
+        return "timeout";
+    case IcsDiagEvent::DIAG_SHORT_REPLY:
+        return "short reply";
+    case IcsDiagEvent::DIAG_HEADER_MISMATCH:
+        return "reply header does not match the command";
+    case IcsDiagEvent::DIAG_STALE_BYTES:
+        return "stale bytes discarded";
+    }
+    return "unknown";
+}
+
+/**
+ *@brief Print one event to stderr
+ *@param[in] &event Event to print
+ **/
+void IcsDiagLogger::print(const IcsDiagEvent &event)
+{
+    fprintf(stderr, "[%lld.%06lld] bus %d id %d cmd 0x%02X: %s (expected %d, got %d)",
+            event.timestampNs / IcsClock::NS_PER_S, (event.timestampNs % IcsClock::NS_PER_S) / IcsClock::NS_PER_US,
+            event.bus, event.id, event.cmd, codeName(event.code), event.expected, event.received);
+    if (event.err != 0)
+        fprintf(stderr, ": %s", strerror(event.err));
+    fprintf(stderr, "\n");
+}
+
+/**
+ *@brief Body of the consumer thread
+ *@param[in] periodMs Time between two drains (ms)
+ **/
+void IcsDiagLogger::consumerLoop(unsigned int periodMs)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping)
+    {
+        guard.unlock();
+        drain();
+        guard.lock();
+        stop_cv.wait_for(guard, std::chrono::milliseconds(periodMs), [this] { return stopping; });
+    }
+    guard.unlock();
+    drain();
+}
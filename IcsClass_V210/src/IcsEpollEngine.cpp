@@ -0,0 +1,263 @@
+/**
+ *@file IcsEpollEngine.cpp
+ *@brief Drives several ICS buses from a single thread with epoll
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <iostream>
+#include <sys/epoll.h>
+#include "IcsEpollEngine.h"
+
+/**
+ *@brief constructor
+ **/
+IcsEpollEngine::IcsEpollEngine()
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        std::cerr << "Failed to create the epoll instance" << std::endl;
+}
+
+/**
+ *@brief destructor
+ *@post The buses are left open, they belong to the caller
+ **/
+IcsEpollEngine::~IcsEpollEngine()
+{
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+/**
+ *@brief Add a bus created by the caller
+ *@param[in] bus Bus object. Must outlive the engine.
+ *@return Bus index
+ *@retval -1 The port could not be watched
+ **/
+int IcsEpollEngine::addBus(IcsHardSerialClass &bus)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = buses.size();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bus.getFd(), &ev) < 0)
+    {
+        std::cerr << "Failed to add the serial port to epoll" << std::endl;
+        return -1;
+    }
+
+    BusState state;
+    state.bus = &bus;
+    buses.push_back(state);
+    return (int)buses.size() - 1;
+}
+
+/**
+ *@brief Register a servo
+ *@param[in] bus Bus index returned by addBus()
+ *@param[in] id Servo ID on that bus
+ *@return Joint index
+ *@retval -1 Unknown bus
+ **/
+int IcsEpollEngine::addJoint(int bus, unsigned char id)
+{
+    if (bus < 0 || bus >= (int)buses.size())
+        return -1;
+
+    IcsJoint joint;
+    joint.bus = bus;
+    joint.id = id;
+    joints.push_back(joint);
+
+    int index = (int)joints.size() - 1;
+    buses[bus].joints.push_back(index);
+    return index;
+}
+
+/**
+ *@brief Number of buses
+ *@return Bus count
+ **/
+int IcsEpollEngine::getBusCount() const
+{
+    return (int)buses.size();
+}
+
+/**
+ *@brief Number of registered joints
+ *@return Joint count
+ **/
+int IcsEpollEngine::getJointCount() const
+{
+    return (int)joints.size();
+}
+
+/**
+ *@brief Get the location of a joint
+ *@param[in] joint Joint index
+ *@return Bus index and servo ID
+ **/
+const IcsJoint &IcsEpollEngine::getJoint(int joint) const
+{
+    return joints[joint];
+}
+
+/**
+ *@brief Run the same command on every joint, interleaving the buses
+ *@param[in] type Command to run
+ *@param[in] values Per-joint values (getJointCount() entries), may be null for getters
+ *@param[out] results Per-joint return values (getJointCount() entries), may be null
+ *@retval true Every joint answered
+ *@retval false At least one joint returned #ICS_FALSE
+ **/
+bool IcsEpollEngine::run(IcsCommand::Type type, const unsigned int *values, int *results)
+{
+    std::vector<int> scratch;
+    if (!results)
+    {
+        scratch.resize(joints.size());
+        results = scratch.data();
+    }
+
+    // Put a command on every bus
+    int active = 0;
+    for (auto &state : buses)
+    {
+        state.next = 0;
+        if (startNext(state, type, values, results))
+            active++;
+    }
+
+    struct epoll_event events[16];
+    while (active > 0)
+    {
+        // Sleep until a reply shows up or the earliest deadline passes.
+        // epoll_wait() counts in ms: round up so a deadline is never cut short, the sweep below catches up.
+        long long earliest = 0;
+        for (auto &state : buses)
+        {
+            if (state.active && (earliest == 0 || state.deadlineNs < earliest))
+                earliest = state.deadlineNs;
+        }
+        long long remaining = earliest - IcsClock::nowNs();
+        int timeoutMs = remaining > 0 ? (int)((remaining + IcsClock::NS_PER_MS - 1) / IcsClock::NS_PER_MS) : 0;
+
+        int n = epoll_wait(epoll_fd, events, 16, timeoutMs);
+        for (int i = 0; i < n; i++)
+        {
+            BusState &state = buses[events[i].data.u32];
+            if (!state.active)
+            {
+                // Late bytes on a bus that is done: count and drop them, or epoll keeps waking us up
+                state.bus->resync();
+                continue;
+            }
+
+            int bytesRead = state.bytesRead;
+            state.bytesRead = state.bus->readAvailable(state.rx, state.rxLen, state.bytesRead);
+            if (state.bytesRead == state.rxLen)
+            {
+                complete(state, results);
+                if (!startNext(state, type, values, results))
+                    active--;
+            }
+            else if (state.bytesRead > bytesRead)
+            {
+                // The reply has started: the next bytes must follow within the inter-byte timeout, as in synchronize()
+                long long interByte = IcsClock::nowNs() + state.bus->getInterByteTimeoutNs();
+                state.deadlineNs = interByte < state.frameDeadlineNs ? interByte : state.frameDeadlineNs;
+            }
+        }
+
+        // Give up on replies that are late, after a last nonblocking read of what came in meanwhile
+        long long now = IcsClock::nowNs();
+        for (auto &state : buses)
+        {
+            if (state.active && now > state.deadlineNs)
+            {
+                state.bytesRead = state.bus->readAvailable(state.rx, state.rxLen, state.bytesRead);
+                complete(state, results);
+                if (!startNext(state, type, values, results))
+                    active--;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < joints.size(); i++)
+    {
+        if (results[i] == IcsBaseClass::ICS_FALSE)
+            return false;
+    }
+    return true;
+}
+
+/**
+ *@brief Send a target position to every joint
+ *@param[in] pos Per-joint target positions
+ *@param[out] results Per-joint returned positions (may be null)
+ *@retval true Every joint answered
+ *@retval false At least one joint failed
+ **/
+bool IcsEpollEngine::setPositions(const unsigned int *pos, int *results)
+{
+    return run(IcsCommand::SET_POS, pos, results);
+}
+
+/**
+ *@brief Read the current position of every joint
+ *@param[out] pos Per-joint positions (#ICS_FALSE on failure)
+ *@retval true Every joint answered
+ *@retval false At least one joint failed
+ *@attention Valid from ICS3.6.
+ **/
+bool IcsEpollEngine::readPositions(int *pos)
+{
+    return run(IcsCommand::GET_POS, nullptr, pos);
+}
+
+/**
+ *@brief Send the next command of a bus
+ *@param[in,out] state Bus slot
+ *@param[in] type Command to run
+ *@param[in] values Per-joint values (may be null)
+ *@param[out] results Per-joint results, filled for commands that cannot be sent
+ *@retval true A command is on the wire
+ *@retval false The bus has no more joints in this batch
+ **/
+bool IcsEpollEngine::startNext(BusState &state, IcsCommand::Type type, const unsigned int *values, int *results)
+{
+    while (state.next < state.joints.size())
+    {
+        state.joint = state.joints[state.next++];
+        state.cmd = IcsCommand(type, joints[state.joint].id, values ? values[state.joint] : 0);
+
+        if (!state.cmd.encode(state.tx, state.txLen, state.rxLen) ||
+            !state.bus->beginTransaction(state.tx, state.txLen, state.rxLen))
+        {
+            results[state.joint] = IcsBaseClass::ICS_FALSE;
+            continue;
+        }
+
+        state.active = true;
+        state.bytesRead = 0;
+        state.frameDeadlineNs = IcsClock::deadlineNs(state.bus->getTimeoutNs());
+        state.deadlineNs = state.frameDeadlineNs;
+        return true;
+    }
+    state.active = false;
+    return false;
+}
+
+/**
+ *@brief Close the transaction in progress on a bus and store its result
+ *@param[in,out] state Bus slot
+ *@param[out] results Per-joint results
+ **/
+void IcsEpollEngine::complete(BusState &state, int *results)
+{
+    bool ok = state.bus->finishTransaction(state.tx, state.txLen, state.rx, state.rxLen, state.bytesRead);
+    results[state.joint] = ok ? state.cmd.decode(state.rx) : IcsBaseClass::ICS_FALSE;
+    state.active = false;
+}
@@ -0,0 +1,101 @@
+/**
+ *@file IcsGpioStub.cpp
+ *@brief Stand-in for the wiringPi GPIO library, built when wiringPi is not available
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <time.h>
+#include "wiringPi.h"
+#include "IcsClock.h"
+
+static const int STUB_PINS = 64;      ///< BCM pins remembered by the stub
+static int stub_levels[STUB_PINS];    ///< Last level written to each pin
+static long long stub_epoch_ns = 0;   ///< Time of wiringPiSetupGpio(), origin of millis()/micros()
+
+/**
+ *@brief Initialise the "GPIO"
+ *@retval 0 Always succeeds
+ **/
+int wiringPiSetupGpio(void)
+{
+    if (stub_epoch_ns == 0)
+        stub_epoch_ns = IcsClock::nowNs();
+    return 0;
+}
+
+/**
+ *@brief Set the pin direction (ignored)
+ *@param[in] pin BCM pin number
+ *@param[in] mode INPUT or OUTPUT
+ **/
+void pinMode(int pin, int mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+/**
+ *@brief Remember the level of a pin
+ *@param[in] pin BCM pin number
+ *@param[in] value LOW or HIGH
+ **/
+void digitalWrite(int pin, int value)
+{
+    if (pin >= 0 && pin < STUB_PINS)
+        stub_levels[pin] = value;
+}
+
+/**
+ *@brief Read back the last level written to a pin
+ *@param[in] pin BCM pin number
+ *@return LOW or HIGH
+ **/
+int digitalRead(int pin)
+{
+    if (pin >= 0 && pin < STUB_PINS)
+        return stub_levels[pin];
+    return LOW;
+}
+
+/**
+ *@brief Sleep
+ *@param[in] howLong Time (ms)
+ **/
+void delay(unsigned int howLong)
+{
+    struct timespec ts = IcsClock::toTimespec(howLong * IcsClock::NS_PER_MS);
+    nanosleep(&ts, NULL);
+}
+
+/**
+ *@brief Wait
+ *@param[in] howLong Time (us)
+ *@note Always sleeps, unlike wiringPi which busy-waits below 100 us: the servos on a simulator host are another
+ *      thread (IcsServoSim) that needs the CPU while the bus waits.
+ **/
+void delayMicroseconds(unsigned int howLong)
+{
+    struct timespec ts = IcsClock::toTimespec(howLong * IcsClock::NS_PER_US);
+    nanosleep(&ts, NULL);
+}
+
+/**
+ *@brief Milliseconds since wiringPiSetupGpio()
+ *@return Time (ms), wraps after 49 days
+ **/
+unsigned int millis(void)
+{
+    return (unsigned int)((IcsClock::nowNs() - stub_epoch_ns) / IcsClock::NS_PER_MS);
+}
+
+/**
+ *@brief Microseconds since wiringPiSetupGpio()
+ *@return Time (us), wraps after 71 minutes
+ **/
+unsigned int micros(void)
+{
+    return (unsigned int)((IcsClock::nowNs() - stub_epoch_ns) / IcsClock::NS_PER_US);
+}
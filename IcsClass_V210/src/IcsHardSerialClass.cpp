@@ -8,8 +8,31 @@
  **/
 
 #include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <time.h>
 #include "IcsHardSerialClass.h"
 
+const int IcsHardSerialClass::SERIAL_PINS[10] = {14, 15, 0, 1, 4, 5, 8, 9, 12, 13};
+const int IcsHardSerialClass::ENABLE_PINS[5] = {18, 7, 6, 25, 19};
+
+/**
+ *@brief Enable pin wired to a UART on the HDS PCB
+ *@param[in] device UART device name (/dev/ttyAMA0 to /dev/ttyAMA4)
+ *@return Pin number (BCM numbering)
+ *@retval -1 Not one of the PCB's UARTs
+ **/
+int IcsHardSerialClass::defaultEnablePin(const char *device)
+{
+    if (!device || strncmp(device, "/dev/ttyAMA", 11) != 0)
+        return -1;
+    const char *n = device + 11;
+    if (n[0] < '0' || n[0] > '4' || n[1] != 0)
+        return -1;
+    return ENABLE_PINS[n[0] - '0'];
+}
+
 /**
  *@brief constructor
  *@param[in] device UART device name
@@ -21,6 +44,8 @@ IcsHardSerialClass::IcsHardSerialClass(const char *device, unsigned char enpin,
 {
     int fd; ///< File descriptor
 
+    latency_default.reset(new IcsBusLatency);
+
     // Wiring Pi setup. Use BCM numbering of pins
     wiringPiSetupGpio();
 
@@ -31,7 +56,7 @@ IcsHardSerialClass::IcsHardSerialClass(const char *device, unsigned char enpin,
     bool flag_pin_intereference = false;
     for (int i = 0; i < 10; i++)
     {
-        if (enpin == serialPinsList[i])
+        if (enpin == SERIAL_PINS[i])
         {
             std::cerr << "The defined enable pin is already in use, swithcing to enpin = " << enpin_default << std::endl;
             flag_pin_intereference = true;
@@ -79,6 +104,9 @@ IcsHardSerialClass::IcsHardSerialClass(const char *device, unsigned char enpin,
         std::cerr << "Failed to flush the serial port I/O buffers" << std::endl;
     }
 
+    // Baseline of the driver error counters (not every driver has them)
+    icount_valid = (ioctl(fd_default, TIOCGICOUNT, &icount_last) == 0);
+
     // Get the serial port attributes
     if (ioctl(fd_default, TCGETS2, &opt) < 0)
     {
@@ -96,6 +124,7 @@ IcsHardSerialClass::IcsHardSerialClass(const char *device, unsigned char enpin,
     opt.c_ispeed = baudrate; // Set input baud rate
     opt.c_ospeed = baudrate; // Set output baud rate
     baudrate_default = baudrate;
+    timing_default = IcsTimingModel(baudrate_default);
     std::cout << "Set the baudrate at: " << baudrate_default << std::endl;
 
     // Set 8-bit data frame and even parity
@@ -116,12 +145,14 @@ IcsHardSerialClass::IcsHardSerialClass(const char *device, unsigned char enpin,
     opt.c_lflag &= ~ECHONL;                                                      // Disable new-line echo
     opt.c_lflag &= ~ISIG;                                                        // Disable interpretation of INTR, QUIT and SUSP
     opt.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL); // Disable special handling of received bytes
+    opt.c_iflag |= INPCK | IGNPAR;                                               // Drop bytes with parity errors, the reply then comes up short
 
     // Prevent special interpretation of output bytes and conversion of newline
     opt.c_oflag &= ~OPOST; // Prevent special interpretation of output bytes
     opt.c_oflag &= ~ONLCR; // Prevent conversion of newline to carriage return/line feed
 
-    timeout_default = timeout;               // Used during reading manually
+    setTimeout(timeout);                     // Used during reading manually
+    interbyte_timeout_ns = 10LL * timing_default.charNs() + 100 * IcsClock::NS_PER_US; // 10 character times + margin
     // opt.c_cc[VTIME] = timeout_default / 100; // Convert timeout from milliseconds to tenths of a second
     // opt.c_cc[VMIN] = 1;
 
@@ -147,6 +178,8 @@ IcsHardSerialClass::~IcsHardSerialClass()
 {
     if (fd_default >= 0)
     {
+        if (rs485_backup_valid)
+            ioctl(fd_default, TIOCSRS485, &rs485_backup); // Reset the RS-485 settings
         ioctl(fd_default, TCSETS2, &opt_backup); // Reset the serial port settings
         close(fd_default);                       // Close UART file descriptor
     }
@@ -155,86 +188,581 @@ IcsHardSerialClass::~IcsHardSerialClass()
 // function rewritten for raspberrry pi
 bool IcsHardSerialClass::synchronize(unsigned char *txBuf, unsigned char txLen, unsigned char *rxBuf, unsigned char rxLen)
 {
-    // Enable transmission
-    digitalWrite(enpin_default, HIGH);
+    if (!beginTransaction(txBuf, txLen, rxLen))
+        return false;
+
+    // Gather exactly rxLen reply bytes (never more, so rxBuf cannot overflow) before the deadline of this transaction
+    int bytesRead = readFrame(rxBuf, rxLen, IcsClock::deadlineNs(timeout_ns));
 
-    // Write the tx buffer, write: blocking call
-    if (write(fd_default, txBuf, txLen) != txLen)
+    // The reply of a timed out command may show up only now, ahead of ours, and pass for it when the command and ID
+    // match. Our own reply then follows right behind it: take that one and count the first as stale.
+    if (bytesRead == rxLen && resync_after_timeout && waitForReply(IcsClock::deadlineNs(interbyte_timeout_ns)))
     {
-        std::cerr << "Failed to write all " << txLen << "bytes to the serial port" << std::endl;
-        return false;
+        recordDiag(IcsDiagEvent::DIAG_STALE_BYTES, rxLen, bytesRead);
+        stats_default.staleBytes += bytesRead;
+        stats_default.lateReplies++;
+        resync_after_timeout = false;
+        bytesRead = readFrame(rxBuf, rxLen, IcsClock::deadlineNs(timeout_ns));
     }
-    // Keep enable HIGH till the transmission is complete
-    if (baudrate_default == 115200)
-		delayMicroseconds(180);
-	else
-		delayMicroseconds(20); // For 1250000
 
-    // Disable transmission, start listening
-    digitalWrite(enpin_default, LOW);
+    return finishTransaction(txBuf, txLen, rxBuf, rxLen, bytesRead);
+}
+
+/**
+ *@brief First half of synchronize(): send the command and hand the bus over to the servo
+ *@param[in] *txBuf Command frame
+ *@param[in] txLen Number of bytes to send
+ *@param[in] rxLen Number of reply bytes (used for the timing model)
+ *@retval true The command is on the wire, the reply can be collected with readAvailable()
+ *@retval false Write failure
+ *@note In GPIO mode this blocks for the wire time of the command, because the enable pin must be dropped on time.
+ **/
+bool IcsHardSerialClass::beginTransaction(const unsigned char *txBuf, unsigned char txLen, unsigned char rxLen)
+{
+    stats_default.transactions++;
 
-	// Return delay time
-    if (baudrate_default == 115200)
-		delayMicroseconds(100);
-	else
-		delayMicroseconds(50); // For 1250000
+    // Throw away input when the previous exchange left the stream in doubt, or when bytes are waiting although it
+    // succeeded: a duplicated or late reply would otherwise be read as the reply to this command
+    if (!resync_pending)
+    {
+        int pending = 0;
+        resync_pending = (ioctl(fd_default, FIONREAD, &pending) == 0) && pending > 0;
+    }
+    if (resync_pending)
+        resync();
 
-    // Start reading the data  3 reply bytes. We are expecting a total of rxLen bytes.
-    int fion = 0;
-    unsigned int readStartTime = micros();
-    unsigned int currTime = readStartTime;
-    
-    // Read number of bytes received (should have 3 bytes back by now)
-    ioctl(fd_default, FIONREAD, &fion);
-    // If not a single byte has been received, wait a little more and check again
-    while (fion < 1)
-	{	
-		// Wait a little more
-		delayMicroseconds(50);
-		
-		// received something? get out
-		ioctl(fd_default, FIONREAD, &fion);
-		if (fion)
-			break;
-		
-		// Nothing yet? Check your watch till TO
-		currTime = micros();
-		if ((currTime - readStartTime) > timeout_default)
+    // Events from here on belong to this command (stale bytes above were the previous one's)
+    tx_cmd_default = txBuf[0];
+    tx_start_ns = IcsClock::nowNs();
+    rx_first_ns = 0;
+
+    if (dirmode_default == DIR_MODE_RS485)
+    {
+        // The driver raises RTS, sends and drops RTS after the last stop bit by itself
+        ssize_t written = write(fd_default, txBuf, txLen);
+        if (written != txLen)
         {
-            std::cout << "Timeout" << std::endl;
-            break;
+            recordDiag(IcsDiagEvent::DIAG_WRITE_FAILED, txLen, (int)written, (written < 0) ? errno : 0);
+            stats_default.failures++;
+            resync_pending = true;
+            return false;
         }
-	}
-    
-    // Read byte by byte until there is no more to read
-    unsigned char reChar;
-    int bytesRead = 0;
-    bool flag_incorrect_bytes_read = false;
-    while (fion > 0)
+        tx_done_ns = IcsClock::nowNs(); // The driver is still sending, this only covers write()
+    }
+    else
     {
-        read(fd_default, &reChar, sizeof(reChar));
-        rxBuf[bytesRead] = reChar;
-        bytesRead++;
+        // Enable transmission
+        digitalWrite(enpin_default, HIGH);
 
-        if (bytesRead > rxLen) // Prevent buffer overflow
+        // Write the tx buffer, write: blocking call
+        ssize_t written = write(fd_default, txBuf, txLen);
+        if (written != txLen)
         {
-            std::cerr << "bytesRead more than expected rxLen." << std::endl;
-            flag_incorrect_bytes_read = true;
+            digitalWrite(enpin_default, LOW);
+            recordDiag(IcsDiagEvent::DIAG_WRITE_FAILED, txLen, (int)written, (written < 0) ? errno : 0);
+            stats_default.failures++;
+            resync_pending = true;
+            return false;
         }
+        // Keep enable HIGH till the last stop bit has left the shift register
+        waitTxDrained(timing_default.transaction(txLen, rxLen));
 
-        // Check available bytes again and update fion
-        ioctl(fd_default, FIONREAD, &fion);
+        // Disable transmission, start listening. The reply is waited for by the caller
+        digitalWrite(enpin_default, LOW);
+        tx_done_ns = IcsClock::nowNs();
     }
+    return true;
+}
+
+/**
+ *@brief Collect whatever part of the reply has arrived, without blocking
+ *@param[out] *rxBuf Receive storage buffer
+ *@param[in] rxLen Number of bytes expected
+ *@param[in] bytesRead Number of bytes already stored in rxBuf
+ *@return Number of bytes stored in rxBuf now (never more than rxLen)
+ **/
+int IcsHardSerialClass::readAvailable(unsigned char *rxBuf, unsigned char rxLen, int bytesRead)
+{
+    if (bytesRead >= rxLen)
+        return bytesRead;
+
+    ssize_t n = read(fd_default, rxBuf + bytesRead, rxLen - bytesRead);
+    if (n > 0)
+    {
+        if (bytesRead == 0)
+            rx_first_ns = IcsClock::nowNs();
+        bytesRead += n;
+    }
+    return bytesRead;
+}
+
+/**
+ *@brief Second half of synchronize(): judge the reply and update the statistics
+ *@param[in] *txBuf Command frame that was sent
+ *@param[in] txLen Number of bytes sent
+ *@param[in] *rxBuf Reply collected so far
+ *@param[in] rxLen Number of bytes expected
+ *@param[in] bytesRead Number of bytes actually received
+ *@retval true Complete reply that matches the command
+ *@retval false Short reply, timeout or reply to another command
+ **/
+bool IcsHardSerialClass::finishTransaction(const unsigned char *txBuf, unsigned char txLen, const unsigned char *rxBuf, unsigned char rxLen, int bytesRead)
+{
+    if (latency_enabled)
+        latency_default->record(txBuf[0], rxLen, bytesRead, tx_start_ns, tx_done_ns, rx_first_ns, IcsClock::nowNs());
 
     if (bytesRead != rxLen)
     {
-        std::cerr << "Failed to read expected number of bytes. Expected: " << rxLen << " Actually read: " << bytesRead << std::endl;
-        flag_incorrect_bytes_read = true;
+        recordDiag((bytesRead == 0) ? IcsDiagEvent::DIAG_TIMEOUT : IcsDiagEvent::DIAG_SHORT_REPLY, rxLen, bytesRead);
+        stats_default.shortReplies++;
+        stats_default.failures++;
+        resync_pending = true;
+        resync_after_timeout = (bytesRead == 0);
+        return false;
+    }
+
+    // A reply that does not belong to this command means we are out of step with the stream
+    if (!checkReply(txBuf, txLen, rxBuf))
+    {
+        recordDiag(IcsDiagEvent::DIAG_HEADER_MISMATCH, rxLen, bytesRead);
+        stats_default.headerErrors++;
+        stats_default.failures++;
+        stats_default.staleBytes += bytesRead; // Consumed as a reply, but they were not ours
+        resync_pending = true;
+        return false;
+    }
+
+    resync_after_timeout = false;
+    return true;
+}
+
+/**
+ *@brief Get the UART file descriptor, e.g. to wait on it with epoll
+ *@return File descriptor (-1 if the port could not be opened)
+ **/
+int IcsHardSerialClass::getFd() const
+{
+    return fd_default;
+}
+
+/**
+ *@brief Change the reception timeout
+ *@param[in] timeout Reception timeout (ms)
+ **/
+void IcsHardSerialClass::setTimeout(unsigned int timeout)
+{
+    timeout_default = timeout;
+    timeout_ns = timeout * IcsClock::NS_PER_MS;
+}
+
+/**
+ *@brief Get the reception timeout
+ *@return Timeout (ms)
+ **/
+unsigned int IcsHardSerialClass::getTimeout() const
+{
+    return timeout_default;
+}
+
+/**
+ *@brief Get the reception timeout in the unit used for deadlines
+ *@return Timeout (ns)
+ **/
+long long IcsHardSerialClass::getTimeoutNs() const
+{
+    return timeout_ns;
+}
+
+/**
+ *@brief Get the transaction counters of this bus
+ *@return Counters accumulated since construction or the last resetStats()
+ **/
+const IcsBusStats &IcsHardSerialClass::getStats() const
+{
+    return stats_default;
+}
+
+/**
+ *@brief Clear the transaction counters
+ **/
+void IcsHardSerialClass::resetStats()
+{
+    stats_default = IcsBusStats();
+}
+
+/**
+ *@brief Check that a reply answers the command that was sent
+ *@param[in] *txBuf Command sent
+ *@param[in] txLen Number of bytes sent
+ *@param[in] *rxBuf Complete reply
+ *@retval true The reply header matches
+ *@retval false The reply belongs to another command or is corrupted
+ *@note Position, read and write replies echo the command byte with bit 7 cleared. Read and write replies also echo
+ *      the sub command. ID replies only carry 0b111 in the upper bits.
+ **/
+bool IcsHardSerialClass::checkReply(const unsigned char *txBuf, unsigned char txLen, const unsigned char *rxBuf)
+{
+    unsigned char cmd = txBuf[0] & 0xE0;
+
+    if (cmd == 0xE0) // ID read/write
+        return (rxBuf[0] & 0xE0) == 0xE0;
+
+    if (rxBuf[0] != (txBuf[0] & 0x7F))
+        return false;
+
+    if ((cmd == 0xA0 || cmd == 0xC0) && txLen > 1) // Read/write: sub command echo
+        return rxBuf[1] == txBuf[1];
+
+    return true;
+}
+
+/**
+ *@brief Discard whatever is left of old replies before the next command
+ *@note Bytes are read out until the line has been quiet for two character times (at most the reply timeout), so
+ *      the tail of a reply still on the wire is not left to break the next transaction. They are counted, so a
+ *      servo that answers late shows up in the statistics.
+ **/
+void IcsHardSerialClass::resync()
+{
+    unsigned char scratch[64];
+    ssize_t n;
+    unsigned long discarded = 0;
+    long long limit = IcsClock::deadlineNs(timeout_ns);
+
+    while (true)
+    {
+        while ((n = read(fd_default, scratch, sizeof scratch)) > 0)
+            discarded += n;
+        long long quiet = IcsClock::deadlineNs(2LL * timing_default.charNs());
+        if (!waitForReply((quiet < limit) ? quiet : limit))
+            break;
     }
 
-    // Flush the read and write buffers
     ioctl(fd_default, TCFLSH, TCIOFLUSH);
 
+    stats_default.resyncs++;
+    stats_default.staleBytes += discarded;
+    if (discarded > 0)
+        recordDiag(IcsDiagEvent::DIAG_STALE_BYTES, 0, (int)discarded);
+    if (resync_after_timeout && discarded > 0)
+    {
+        stats_default.lateReplies++;
+        resync_after_timeout = false;
+    }
+
+    // Attribute the line errors seen since the last resync
+    if (icount_valid)
+    {
+        struct serial_icounter_struct icount;
+        if (ioctl(fd_default, TIOCGICOUNT, &icount) == 0)
+        {
+            stats_default.parityErrors += icount.parity - icount_last.parity;
+            stats_default.frameErrors += icount.frame - icount_last.frame;
+            unsigned long overruns = (icount.overrun - icount_last.overrun) + (icount.buf_overrun - icount_last.buf_overrun);
+            stats_default.overruns += overruns;
+            latency_default->addOverruns(overruns);
+            icount_last = icount;
+        }
+    }
+
+    // A reply that has not shown up yet may still arrive before the next command (resync_after_timeout stays set)
+    resync_pending = false;
+}
 
-    return true && (!flag_incorrect_bytes_read);
+/**
+ *@brief Select how synchronize() waits for the servo reply
+ *@param[in] mode #RX_MODE_SPIN (FIONREAD busy-wait) or #RX_MODE_POLL (kernel wait with ppoll)
+ **/
+void IcsHardSerialClass::setRxMode(RxMode mode)
+{
+    rxmode_default = mode;
+}
+
+/**
+ *@brief Get the current reply wait strategy
+ *@return Receive mode in use
+ **/
+IcsHardSerialClass::RxMode IcsHardSerialClass::getRxMode() const
+{
+    return rxmode_default;
+}
+
+/**
+ *@brief Let the UART driver switch the half-duplex buffer through RTS (TIOCSRS485)
+ *@param[in] rtsOnSend true: RTS high while sending (buffer enable active high), false: RTS low while sending
+ *@param[in] delayRtsBeforeSend Delay between raising RTS and the first start bit (ms, as defined by the kernel)
+ *@param[in] delayRtsAfterSend Delay between the last stop bit and releasing RTS (ms, as defined by the kernel)
+ *@retval true The driver accepted the RS-485 configuration
+ *@retval false Not supported by the driver, the enable pin (GPIO) path stays in use
+ *@attention The buffer enable line must be wired to the RTS pin of the UART.
+ **/
+bool IcsHardSerialClass::setRs485Mode(bool rtsOnSend, unsigned int delayRtsBeforeSend, unsigned int delayRtsAfterSend)
+{
+    struct serial_rs485 rs485;
+
+    if (!rs485_backup_valid)
+    {
+        if (ioctl(fd_default, TIOCGRS485, &rs485_backup) < 0)
+        {
+            std::cerr << "RS-485 mode not supported by this port, keeping the enable pin" << std::endl;
+            return false;
+        }
+        rs485_backup_valid = true;
+    }
+
+    rs485 = rs485_backup;
+    rs485.flags |= SER_RS485_ENABLED;
+    if (rtsOnSend)
+    {
+        rs485.flags |= SER_RS485_RTS_ON_SEND;
+        rs485.flags &= ~SER_RS485_RTS_AFTER_SEND;
+    }
+    else
+    {
+        rs485.flags &= ~SER_RS485_RTS_ON_SEND;
+        rs485.flags |= SER_RS485_RTS_AFTER_SEND;
+    }
+    rs485.flags &= ~SER_RS485_RX_DURING_TX; // Do not receive our own request
+    rs485.delay_rts_before_send = delayRtsBeforeSend;
+    rs485.delay_rts_after_send = delayRtsAfterSend;
+
+    if (ioctl(fd_default, TIOCSRS485, &rs485) < 0)
+    {
+        std::cerr << "Failed to enable RS-485 mode, keeping the enable pin" << std::endl;
+        return false;
+    }
+
+    // Keep the GPIO buffer enable released, RTS is in charge now
+    digitalWrite(enpin_default, LOW);
+    dirmode_default = DIR_MODE_RS485;
+    return true;
+}
+
+/**
+ *@brief Go back to switching the buffer with the enable pin
+ **/
+void IcsHardSerialClass::setGpioMode()
+{
+    if (rs485_backup_valid)
+        ioctl(fd_default, TIOCSRS485, &rs485_backup);
+    digitalWrite(enpin_default, LOW);
+    dirmode_default = DIR_MODE_GPIO;
+}
+
+/**
+ *@brief Get the current direction control strategy
+ *@return Direction mode in use
+ **/
+IcsHardSerialClass::DirMode IcsHardSerialClass::getDirMode() const
+{
+    return dirmode_default;
+}
+
+/**
+ *@brief Get the wire timing model of this port
+ *@return Timing model built from the configured baud rate
+ **/
+const IcsTimingModel &IcsHardSerialClass::getTimingModel() const
+{
+    return timing_default;
+}
+
+/**
+ *@brief Return once the command has physically left the UART
+ *@param[in] timing Timing of the current transaction
+ *@note Sleeps for all but the last character of the command, then polls the line status (TIOCSERGETLSR) until the
+ *      transmitter is empty. Drivers without line status support fall back to the computed wire time plus one bit.
+ **/
+void IcsHardSerialClass::waitTxDrained(const IcsTransactionTiming &timing)
+{
+    delayMicroseconds(timing.txSleepNs / 1000);
+
+    if (lsr_support != 0)
+    {
+        unsigned int lsr = 0;
+        long long pollDeadline = IcsClock::deadlineNs(timing.txReleaseNs - timing.txSleepNs + 4LL * timing.charNs);
+
+        while (true)
+        {
+            if (ioctl(fd_default, TIOCSERGETLSR, &lsr) < 0)
+            {
+                lsr_support = 0; // Not available on this port, use the time model from now on
+                break;
+            }
+            lsr_support = 1;
+            if ((lsr & TIOCSER_TEMT) || (IcsClock::nowNs() > pollDeadline))
+                return;
+        }
+    }
+
+    delayMicroseconds((timing.txReleaseNs - timing.txSleepNs + 999) / 1000);
+}
+
+/**
+ *@brief Set the maximum silence allowed between two bytes of the same reply
+ *@param[in] timeout Inter-byte timeout (us)
+ **/
+void IcsHardSerialClass::setInterByteTimeout(unsigned int timeout)
+{
+    interbyte_timeout_ns = timeout * IcsClock::NS_PER_US;
+}
+
+/**
+ *@brief Get the inter-byte timeout
+ *@return Inter-byte timeout (us)
+ **/
+unsigned int IcsHardSerialClass::getInterByteTimeout() const
+{
+    return interbyte_timeout_ns / IcsClock::NS_PER_US;
+}
+
+/**
+ *@brief Get the inter-byte timeout in the unit used for deadlines
+ *@return Inter-byte timeout (ns)
+ **/
+long long IcsHardSerialClass::getInterByteTimeoutNs() const
+{
+    return interbyte_timeout_ns;
+}
+
+/**
+ *@brief Wait until at least one reply byte is available or the deadline passes
+ *@param[in] deadlineNs Absolute CLOCK_MONOTONIC deadline (ns)
+ *@retval true Data is ready to be read
+ *@retval false Timeout or error
+ **/
+bool IcsHardSerialClass::waitForReply(long long deadlineNs)
+{
+    if (rxmode_default == RX_MODE_POLL)
+    {
+        // Sleep in the kernel until the UART has data for us
+        struct pollfd pfd;
+        pfd.fd = fd_default;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        struct timespec ts = IcsClock::toTimespec(deadlineNs - IcsClock::nowNs());
+        int ret = ppoll(&pfd, 1, &ts, NULL);
+        return (ret > 0) && (pfd.revents & POLLIN);
+    }
+
+    // Spin on the number of bytes received until something shows up
+    int fion = 0;
+    ioctl(fd_default, FIONREAD, &fion);
+    while (fion < 1)
+    {
+        // Nothing yet? Check your watch till TO
+        if (IcsClock::nowNs() > deadlineNs)
+            return false;
+
+        // Wait a little more
+        delayMicroseconds(50);
+        ioctl(fd_default, FIONREAD, &fion);
+    }
+    return true;
+}
+
+/**
+ *@brief Read exactly rxLen bytes of a reply
+ *@param[out] *rxBuf Receive storage buffer
+ *@param[in] rxLen Number of bytes expected
+ *@param[in] deadlineNs Absolute CLOCK_MONOTONIC time by which the whole frame must be in (ns)
+ *@return Number of bytes actually stored in rxBuf (0 to rxLen)
+ *@note Each read() asks for all the bytes still missing, so a complete frame usually takes a single read.
+ *@note Once the reply has started, consecutive chunks must also arrive within the inter-byte timeout.
+ **/
+int IcsHardSerialClass::readFrame(unsigned char *rxBuf, unsigned char rxLen, long long deadlineNs)
+{
+    int bytesRead = 0;
+
+    // Frame deadline, tightened to the inter-byte deadline once the reply has started
+    long long waitUntil = deadlineNs;
+
+    while (bytesRead < rxLen)
+    {
+        if (!waitForReply(waitUntil))
+            break;
+
+        ssize_t n = read(fd_default, rxBuf + bytesRead, rxLen - bytesRead);
+        if (n > 0)
+        {
+            long long now = IcsClock::nowNs();
+            if (bytesRead == 0)
+                rx_first_ns = now;
+            bytesRead += n;
+            waitUntil = now + interbyte_timeout_ns;
+            if (waitUntil > deadlineNs)
+                waitUntil = deadlineNs;
+        }
+        else if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            recordDiag(IcsDiagEvent::DIAG_READ_FAILED, rxLen, bytesRead, errno);
+            break;
+        }
+    }
+
+    return bytesRead;
+}
+
+/**
+ *@brief Get the latency histograms and failure counters of this port
+ *@return Histograms per bus, servo ID and command type, safe to snapshot from any thread
+ **/
+IcsBusLatency &IcsHardSerialClass::getLatency()
+{
+    return *latency_default;
+}
+
+/**
+ *@brief Switch the latency recording on or off
+ *@param[in] enabled true: record every transaction (default)
+ **/
+void IcsHardSerialClass::setLatencyEnabled(bool enabled)
+{
+    latency_enabled = enabled;
+}
+
+/**
+ *@brief Check whether latencies are recorded
+ *@retval true Recording
+ **/
+bool IcsHardSerialClass::getLatencyEnabled() const
+{
+    return latency_enabled;
+}
+
+/**
+ *@brief Set the bus number stamped on the diagnostic events of this port
+ *@param[in] busId Bus number (e.g. the UART index)
+ **/
+void IcsHardSerialClass::setBusId(unsigned char busId)
+{
+    bus_id_default = busId;
+}
+
+/**
+ *@brief Get the bus number stamped on the diagnostic events
+ *@return Bus number
+ **/
+unsigned char IcsHardSerialClass::getBusId() const
+{
+    return bus_id_default;
+}
+
+/**
+ *@brief Get the diagnostic event ring of this port, to be drained by one consumer (see IcsDiagLogger)
+ *@return Event ring
+ **/
+IcsDiagRing &IcsHardSerialClass::getDiagRing()
+{
+    return diag_ring;
+}
+
+/**
+ *@brief Number of diagnostic events lost because nobody drained the ring in time
+ *@return Dropped event count
+ **/
+unsigned long IcsHardSerialClass::getDiagDropped() const
+{
+    return diag_dropped.load(std::memory_order_relaxed);
 }
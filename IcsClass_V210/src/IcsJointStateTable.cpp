@@ -0,0 +1,138 @@
+/**
+ *@file IcsJointStateTable.cpp
+ *@brief Seqlock-published snapshot of the last known state of every joint
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <thread>
+#include "IcsJointStateTable.h"
+
+/**
+ *@brief constructor
+ *@param[in] joints Number of joints
+ **/
+IcsJointStateTable::IcsJointStateTable(int joints)
+{
+    resize(joints);
+}
+
+/**
+ *@brief Change the number of joints, clearing all states
+ *@param[in] joints Number of joints
+ *@attention Not safe while readers or writers are active.
+ **/
+void IcsJointStateTable::resize(int joints)
+{
+    count = (joints > 0) ? joints : 0;
+    slots.reset(count ? new Slot[count] : nullptr);
+}
+
+/**
+ *@brief Number of joints
+ *@return Joint count
+ **/
+int IcsJointStateTable::size() const
+{
+    return count;
+}
+
+/**
+ *@brief Start a group of updates that readers will see all at once
+ **/
+void IcsJointStateTable::beginWrite()
+{
+    write_lock.lock();
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ *@brief Update the position of a joint (between beginWrite and endWrite)
+ *@param[in] joint Joint index
+ *@param[in] pos Position reply
+ *@param[in] timestampNs Reply time (ns)
+ **/
+void IcsJointStateTable::setPos(int joint, int pos, long long timestampNs)
+{
+    slots[joint].pos.store(pos, std::memory_order_relaxed);
+    slots[joint].timestampNs.store(timestampNs, std::memory_order_relaxed);
+}
+
+/**
+ *@brief Update the current of a joint (between beginWrite and endWrite)
+ *@param[in] joint Joint index
+ *@param[in] current Current reply
+ *@param[in] timestampNs Reply time (ns)
+ **/
+void IcsJointStateTable::setCurrent(int joint, int current, long long timestampNs)
+{
+    slots[joint].current.store(current, std::memory_order_relaxed);
+    slots[joint].timestampNs.store(timestampNs, std::memory_order_relaxed);
+}
+
+/**
+ *@brief Update the temperature of a joint (between beginWrite and endWrite)
+ *@param[in] joint Joint index
+ *@param[in] temperature Temperature reply
+ *@param[in] timestampNs Reply time (ns)
+ **/
+void IcsJointStateTable::setTemperature(int joint, int temperature, long long timestampNs)
+{
+    slots[joint].temperature.store(temperature, std::memory_order_relaxed);
+    slots[joint].timestampNs.store(timestampNs, std::memory_order_relaxed);
+}
+
+/**
+ *@brief Publish the updates made since beginWrite()
+ **/
+void IcsJointStateTable::endWrite()
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    write_lock.unlock();
+}
+
+/**
+ *@brief Copy a consistent snapshot of the table
+ *@param[out] states Destination (joints entries)
+ *@param[in] joints Number of entries to copy (clipped to size())
+ *@return Version of the snapshot, increases by one with every published write group
+ **/
+unsigned long IcsJointStateTable::read(IcsJointState *states, int joints) const
+{
+    if (joints > count)
+        joints = count;
+
+    while (true)
+    {
+        unsigned long before = seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield(); // Writer in progress
+            continue;
+        }
+
+        for (int i = 0; i < joints; i++)
+        {
+            states[i].pos = slots[i].pos.load(std::memory_order_relaxed);
+            states[i].current = slots[i].current.load(std::memory_order_relaxed);
+            states[i].temperature = slots[i].temperature.load(std::memory_order_relaxed);
+            states[i].timestampNs = slots[i].timestampNs.load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before)
+            return before / 2;
+    }
+}
+
+/**
+ *@brief Version of the latest published snapshot
+ *@return Number of write groups published so far
+ **/
+unsigned long IcsJointStateTable::getVersion() const
+{
+    return seq.load(std::memory_order_acquire) / 2;
+}
@@ -0,0 +1,322 @@
+/**
+ *@file IcsLatency.cpp
+ *@brief Lock-free log-linear latency histograms of the bus transactions
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsLatency.h"
+
+/**
+ *@brief Bucket of a value
+ *@param[in] ns Value (ns)
+ *@return Bucket index, values below 0 go to the first bucket and values from 2^MAX_BITS to the last one
+ **/
+int IcsLatencySnapshot::bucketIndex(long long ns)
+{
+    if (ns < SUB_COUNT)
+        return (ns < 0) ? 0 : (int)ns;
+    if (ns >= (1LL << MAX_BITS))
+        return BUCKETS - 1;
+
+    int msb = 63 - __builtin_clzll((unsigned long long)ns);
+    int shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + (int)((ns >> shift) & (SUB_COUNT - 1));
+}
+
+/**
+ *@brief Smallest value of a bucket
+ *@param[in] index Bucket index
+ *@return Lower bound (ns)
+ **/
+long long IcsLatencySnapshot::bucketLow(int index)
+{
+    if (index < SUB_COUNT)
+        return index;
+    int shift = index / SUB_COUNT - 1;
+    return (long long)(SUB_COUNT + index % SUB_COUNT) << shift;
+}
+
+/**
+ *@brief Largest value of a bucket
+ *@param[in] index Bucket index
+ *@return Upper bound (ns)
+ **/
+long long IcsLatencySnapshot::bucketHigh(int index)
+{
+    if (index < SUB_COUNT)
+        return index;
+    int shift = index / SUB_COUNT - 1;
+    return bucketLow(index) + (1LL << shift) - 1;
+}
+
+/**
+ *@brief Value below which a fraction of the samples lie
+ *@param[in] p Fraction (0.5 for the median, 0.99, 0.999 ...)
+ *@return Upper bound of the bucket holding that sample, clamped to the observed min/max (ns). 0 without samples.
+ **/
+long long IcsLatencySnapshot::percentile(double p) const
+{
+    if (count == 0)
+        return 0;
+    if (p < 0.0)
+        p = 0.0;
+    if (p > 1.0)
+        p = 1.0;
+
+    unsigned long long rank = (unsigned long long)(p * count + 0.999999);
+    if (rank < 1)
+        rank = 1;
+
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            long long value = bucketHigh(i);
+            if (value > maxNs)
+                value = maxNs;
+            if (value < minNs)
+                value = minNs;
+            return value;
+        }
+    }
+    return maxNs;
+}
+
+/**
+ *@brief Average of the samples
+ *@return Mean (ns), 0 without samples
+ **/
+double IcsLatencySnapshot::meanNs() const
+{
+    return count ? (double)sumNs / count : 0.0;
+}
+
+/**
+ *@brief Add the samples of another snapshot, e.g. to combine several buses
+ *@param[in] &other Snapshot to add
+ **/
+void IcsLatencySnapshot::merge(const IcsLatencySnapshot &other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0 || other.minNs < minNs)
+        minNs = other.minNs;
+    if (count == 0 || other.maxNs > maxNs)
+        maxNs = other.maxNs;
+    for (int i = 0; i < BUCKETS; i++)
+        counts[i] += other.counts[i];
+    count += other.count;
+    sumNs += other.sumNs;
+}
+
+/**
+ *@brief constructor
+ **/
+IcsLatencyHistogram::IcsLatencyHistogram()
+{
+    reset();
+}
+
+/**
+ *@brief Add one sample
+ *@param[in] ns Measured time (ns)
+ *@note Single writer: plain relaxed load/store pairs, no read-modify-write instructions.
+ **/
+void IcsLatencyHistogram::record(long long ns)
+{
+    std::atomic<unsigned int> &bucket = counts[IcsLatencySnapshot::bucketIndex(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    unsigned long long n = count.load(std::memory_order_relaxed);
+    if (n == 0 || ns < min_ns.load(std::memory_order_relaxed))
+        min_ns.store(ns, std::memory_order_relaxed);
+    if (n == 0 || ns > max_ns.load(std::memory_order_relaxed))
+        max_ns.store(ns, std::memory_order_relaxed);
+    sum_ns.store(sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    count.store(n + 1, std::memory_order_release);
+}
+
+/**
+ *@brief Clear all samples
+ *@attention Samples recorded at the same time may partly survive.
+ **/
+void IcsLatencyHistogram::reset()
+{
+    for (int i = 0; i < IcsLatencySnapshot::BUCKETS; i++)
+        counts[i].store(0, std::memory_order_relaxed);
+    sum_ns.store(0, std::memory_order_relaxed);
+    min_ns.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_release);
+}
+
+/**
+ *@brief Copy the histogram
+ *@param[out] &out Snapshot
+ *@note count is taken as the sum of the copied buckets, so the percentiles stay consistent even while recording.
+ **/
+void IcsLatencyHistogram::snapshot(IcsLatencySnapshot &out) const
+{
+    count.load(std::memory_order_acquire);
+
+    unsigned long long total = 0;
+    for (int i = 0; i < IcsLatencySnapshot::BUCKETS; i++)
+    {
+        out.counts[i] = counts[i].load(std::memory_order_relaxed);
+        total += out.counts[i];
+    }
+    out.count = total;
+    out.sumNs = sum_ns.load(std::memory_order_relaxed);
+    out.minNs = min_ns.load(std::memory_order_relaxed);
+    out.maxNs = max_ns.load(std::memory_order_relaxed);
+}
+
+/**
+ *@brief constructor
+ **/
+IcsBusLatency::IcsBusLatency()
+{
+    reset();
+}
+
+/**
+ *@brief Scope of a servo ID
+ *@param[in] id Servo ID (0-31)
+ *@return Scope index
+ **/
+int IcsBusLatency::scopeOfId(unsigned char id)
+{
+    return SCOPE_ID + (id & (ID_COUNT - 1));
+}
+
+/**
+ *@brief Scope of a command type
+ *@param[in] cmd Command byte (only the upper 3 bits are used)
+ *@return Scope index, ID read (0xFF) and ID write (0xE0) share one scope
+ **/
+int IcsBusLatency::scopeOfCmd(unsigned char cmd)
+{
+    switch (cmd & 0xE0)
+    {
+    case 0x80:
+        return SCOPE_CMD + 0;
+    case 0xA0:
+        return SCOPE_CMD + 1;
+    case 0xC0:
+        return SCOPE_CMD + 2;
+    default:
+        return SCOPE_CMD + 3;
+    }
+}
+
+/**
+ *@brief Account one finished transaction in the bus, servo and command scopes
+ *@param[in] cmd Command byte sent
+ *@param[in] rxLen Reply bytes expected
+ *@param[in] bytesRead Reply bytes received
+ *@param[in] startNs Time the command started (ns)
+ *@param[in] txDoneNs Time the command had left the UART (ns)
+ *@param[in] firstByteNs Time the first reply byte was read, 0 if none (ns)
+ *@param[in] endNs Time the transaction ended (ns)
+ **/
+void IcsBusLatency::record(unsigned char cmd, int rxLen, int bytesRead, long long startNs, long long txDoneNs, long long firstByteNs, long long endNs)
+{
+    bool complete = (bytesRead == rxLen);
+    bool started = (bytesRead > 0);
+    long long total = endNs - startNs;
+    long long txDrain = txDoneNs - startNs;
+    long long turnaround = started ? firstByteNs - txDoneNs : 0;
+    long long firstByte = started ? firstByteNs - startNs : 0;
+
+    recordScope(SCOPE_BUS, complete, started, total, txDrain, turnaround, firstByte);
+    recordScope(scopeOfCmd(cmd), complete, started, total, txDrain, turnaround, firstByte);
+    if ((cmd & 0xE0) != 0xE0) // ID commands do not address a servo
+        recordScope(scopeOfId(cmd & 0x1F), complete, started, total, txDrain, turnaround, firstByte);
+}
+
+/**
+ *@brief Account UART overruns reported by the driver
+ *@param[in] n Number of new overruns
+ **/
+void IcsBusLatency::addOverruns(unsigned long n)
+{
+    overruns.store(overruns.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ *@brief Copy one histogram
+ *@param[in] scope Scope index (SCOPE_BUS, scopeOfId(), scopeOfCmd())
+ *@param[in] metric Measured part of the transaction
+ *@param[out] &out Snapshot
+ **/
+void IcsBusLatency::snapshot(int scope, Metric metric, IcsLatencySnapshot &out) const
+{
+    histograms[scope][metric].snapshot(out);
+}
+
+/**
+ *@brief Get the failure counters of a scope
+ *@param[in] scope Scope index
+ *@return Counters
+ **/
+IcsLatencyCounters IcsBusLatency::getCounters(int scope) const
+{
+    IcsLatencyCounters counters;
+    counters.transactions = transactions[scope].load(std::memory_order_relaxed);
+    counters.timeouts = timeouts[scope].load(std::memory_order_relaxed);
+    counters.shortReads = short_reads[scope].load(std::memory_order_relaxed);
+    counters.overruns = (scope == SCOPE_BUS) ? overruns.load(std::memory_order_relaxed) : 0;
+    return counters;
+}
+
+/**
+ *@brief Clear all histograms and counters
+ **/
+void IcsBusLatency::reset()
+{
+    for (int s = 0; s < SCOPES; s++)
+    {
+        for (int m = 0; m < LAT_METRICS; m++)
+            histograms[s][m].reset();
+        transactions[s].store(0, std::memory_order_relaxed);
+        timeouts[s].store(0, std::memory_order_relaxed);
+        short_reads[s].store(0, std::memory_order_relaxed);
+    }
+    overruns.store(0, std::memory_order_relaxed);
+}
+
+/**
+ *@brief Account a transaction in one scope
+ *@param[in] scope Scope index
+ *@param[in] complete The whole reply arrived
+ *@param[in] started At least one reply byte arrived
+ *@param[in] total Total time (ns)
+ *@param[in] txDrain Transmit time (ns)
+ *@param[in] turnaround Servo turnaround (ns)
+ *@param[in] firstByte Time to the first reply byte (ns)
+ **/
+void IcsBusLatency::recordScope(int scope, bool complete, bool started, long long total, long long txDrain, long long turnaround, long long firstByte)
+{
+    transactions[scope].store(transactions[scope].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // Timing of failed transactions would only show the timeout, keep the histograms to real replies
+    histograms[scope][LAT_TX_DRAIN].record(txDrain);
+    if (!started)
+    {
+        timeouts[scope].store(timeouts[scope].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    histograms[scope][LAT_TURNAROUND].record(turnaround);
+    histograms[scope][LAT_FIRST_BYTE].record(firstByte);
+    if (!complete)
+    {
+        short_reads[scope].store(short_reads[scope].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    histograms[scope][LAT_TOTAL].record(total);
+}
@@ -0,0 +1,365 @@
+/**
+ *@file IcsRtPolicy.cpp
+ *@brief Real-time scheduling, memory locking and CPU affinity for bus and control threads
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <alloca.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "IcsRtPolicy.h"
+
+/**
+ * @struct IcsSchedAttr
+ * @brief Layout of the kernel's struct sched_attr (SCHED_DEADLINE has no glibc wrapper)
+ **/
+struct IcsSchedAttr
+{
+    unsigned int size;
+    unsigned int sched_policy;
+    unsigned long long sched_flags;
+    int sched_nice;
+    unsigned int sched_priority;
+    unsigned long long sched_runtime;
+    unsigned long long sched_deadline;
+    unsigned long long sched_period;
+};
+
+/**
+ *@brief Check whether a range of the address space is mapped and resident
+ *@param[in] *start First byte, rounded down to its page
+ *@param[in] bytes Length of the range
+ *@retval true Every page is in RAM (mincore)
+ **/
+static bool resident(const void *start, size_t bytes)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = (uintptr_t)start & ~(uintptr_t)(page - 1);
+    size_t pages = ((uintptr_t)start + bytes - first + page - 1) / page;
+
+    std::vector<unsigned char> vec(pages);
+    if (mincore((void *)first, pages * page, vec.data()) < 0)
+        return false; // ENOMEM: part of the range is not even mapped
+    for (size_t i = 0; i < pages; i++)
+    {
+        if (!(vec[i] & 1))
+            return false;
+    }
+    return true;
+}
+
+/**
+ *@brief Check that every mapping of the process is locked
+ *@retval true /proc/self/smaps flags every lockable mapping "lo" (VM_LOCKED)
+ *@note Mappings the kernel never locks (vdso, vvar, I/O and PFN maps, vsyscall) are skipped.
+ **/
+static bool mappingsLocked()
+{
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f)
+        return false;
+
+    char line[512];
+    bool gate = false;
+    bool locked = true;
+    while (locked && fgets(line, sizeof line, f))
+    {
+        if (strncmp(line, "VmFlags:", 8) != 0)
+        {
+            // Mapping header "start-end perms offset dev inode [name]", followed by its fields
+            char *colon = strchr(line, ':');
+            char *space = strchr(line, ' ');
+            if (space && (!colon || colon > space))
+                gate = strstr(line, "[vsyscall]") != NULL;
+            continue;
+        }
+
+        bool lo = false, special = gate;
+        char *save = NULL;
+        for (char *flag = strtok_r(line + 8, " \n", &save); flag; flag = strtok_r(NULL, " \n", &save))
+        {
+            if (strcmp(flag, "lo") == 0)
+                lo = true;
+            else if (!strcmp(flag, "io") || !strcmp(flag, "pf") || !strcmp(flag, "de") || !strcmp(flag, "mm") ||
+                     !strcmp(flag, "ht"))
+                special = true;
+        }
+        locked = lo || special;
+    }
+    fclose(f);
+    return locked;
+}
+
+/**
+ *@brief Check that mlockall(MCL_CURRENT | MCL_FUTURE) is in effect
+ *@retval true Current mappings are locked and new mappings are locked as they are created
+ *@note MCL_FUTURE cannot be read back, so a fresh anonymous page is mapped without touching it: only with MCL_FUTURE
+ *      does the kernel populate it right away.
+ **/
+static bool memoryLocked()
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void *probe = mmap(NULL, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (probe == MAP_FAILED)
+        return false;
+    bool future = resident(probe, page);
+    munmap(probe, page);
+
+    return future && mappingsLocked();
+}
+
+/**
+ *@brief Get the CPUs a thread of this process may be moved to
+ *@param[out] &allowed Online CPUs, by index (online CPUs need not be numbered 0 to N-1)
+ *@note Read from /sys/devices/system/cpu/online ("0,2-3"). The calling thread's own mask is only the fallback: it may
+ *      already have been narrowed by an earlier policy, which must not stop this one from choosing other CPUs.
+ **/
+static void allowedCpus(cpu_set_t &allowed)
+{
+    CPU_ZERO(&allowed);
+    FILE *f = fopen("/sys/devices/system/cpu/online", "r");
+    char line[256];
+    bool listed = false;
+    if (f && fgets(line, sizeof line, f))
+    {
+        char *p = line;
+        while (true)
+        {
+            char *end;
+            long first = strtol(p, &end, 10);
+            if (end == p)
+                break;
+            long last = first;
+            if (*end == '-')
+                last = strtol(end + 1, &end, 10);
+            for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+                CPU_SET(cpu, &allowed);
+            listed = true;
+            if (*end != ',')
+                break;
+            p = end + 1;
+        }
+    }
+    if (f)
+        fclose(f);
+    if (!listed && sched_getaffinity(0, sizeof allowed, &allowed) < 0)
+        CPU_ZERO(&allowed);
+}
+
+/**
+ *@brief Check that a CPU index can be put in an affinity mask
+ *@param[in] cpu CPU index
+ *@param[in] &allowed CPUs returned by allowedCpus()
+ *@retval true Below CPU_SETSIZE and online
+ **/
+static bool validCpu(int cpu, const cpu_set_t &allowed)
+{
+    return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed);
+}
+
+/**
+ *@brief Check that the stack below the caller is prefaulted
+ *@param[in] bytes Stack size that must be resident below the current frame
+ *@retval true Every page is mapped and resident
+ **/
+static bool stackResident(size_t bytes)
+{
+    volatile char here = 0;
+    return resident((const char *)&here - bytes, bytes);
+}
+
+/**
+ *@brief Touch the stack below the caller so its pages are in RAM
+ *@param[in] bytes Stack size to prefault
+ *@note Not inlined: the touched area is released on return, so check() called next finds it below its own frame.
+ *      One page more than asked covers the frame size difference.
+ **/
+static __attribute__((noinline)) void prefaultStack(size_t bytes)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    bytes += page;
+    volatile char *stack = (volatile char *)alloca(bytes);
+    for (size_t i = 0; i < bytes; i += page)
+        stack[i] = 0;
+    stack[bytes - 1] = 0;
+}
+
+/**
+ *@brief Apply the policy to the calling thread
+ *@return What took effect, as read back by check()
+ **/
+IcsRtReport IcsRtPolicy::apply() const
+{
+    IcsRtReport report;
+
+    // Lock memory first so the stack prefault below stays resident
+    if (lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+        report.memoryLockErrno = errno;
+
+    if (prefaultStackBytes > 0)
+        prefaultStack(prefaultStackBytes);
+
+    if (!cpus.empty())
+    {
+        cpu_set_t set, allowed;
+        CPU_ZERO(&set);
+        allowedCpus(allowed);
+        for (int cpu : cpus)
+        {
+            if (!validCpu(cpu, allowed))
+            {
+                report.affinityErrno = EINVAL;
+                break;
+            }
+            CPU_SET(cpu, &set);
+        }
+        if (report.affinityErrno == 0 && sched_setaffinity(0, sizeof set, &set) < 0)
+            report.affinityErrno = errno;
+    }
+
+    if (timerSlackNs >= 0 && prctl(PR_SET_TIMERSLACK, (unsigned long)timerSlackNs, 0, 0, 0) < 0)
+        report.timerSlackErrno = errno;
+
+    if (scheduler == RT_SCHED_FIFO)
+    {
+        struct sched_param param;
+        param.sched_priority = priority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+            report.schedulerErrno = errno;
+    }
+    else if (scheduler == RT_SCHED_DEADLINE)
+    {
+        IcsSchedAttr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.sched_policy = SCHED_DEADLINE;
+        attr.sched_runtime = runtimeNs;
+        attr.sched_deadline = deadlineNs ? deadlineNs : periodNs;
+        attr.sched_period = periodNs;
+        if (syscall(SYS_sched_setattr, 0, &attr, 0) < 0)
+            report.schedulerErrno = errno;
+    }
+
+    // Report what the kernel says, not what we hoped for
+    IcsRtReport effective = check();
+    effective.schedulerErrno = report.schedulerErrno;
+    effective.affinityErrno = report.affinityErrno;
+    effective.memoryLockErrno = report.memoryLockErrno;
+    effective.timerSlackErrno = report.timerSlackErrno;
+    if (report.memoryLockErrno)
+        effective.memoryLockOk = false;
+    return effective;
+}
+
+/**
+ *@brief Compare the calling thread's current settings with the policy
+ *@return Which requested settings are in effect (settings left unchanged by the policy count as ok)
+ *@note Call from the thread the policy was applied to: the stack check looks below the caller's frame.
+ **/
+IcsRtReport IcsRtPolicy::check() const
+{
+    IcsRtReport report;
+
+    if (scheduler == RT_SCHED_FIFO)
+    {
+        struct sched_param param;
+        report.schedulerOk = (sched_getscheduler(0) == SCHED_FIFO) && (sched_getparam(0, &param) == 0) &&
+                             (param.sched_priority == priority);
+    }
+    else if (scheduler == RT_SCHED_DEADLINE)
+    {
+        report.schedulerOk = (sched_getscheduler(0) == SCHED_DEADLINE);
+    }
+
+    if (!cpus.empty())
+    {
+        cpu_set_t want, have, allowed;
+        CPU_ZERO(&want);
+        allowedCpus(allowed);
+        report.affinityOk = true;
+        for (int cpu : cpus)
+        {
+            if (!validCpu(cpu, allowed))
+                report.affinityOk = false;
+            else
+                CPU_SET(cpu, &want);
+        }
+        report.affinityOk = report.affinityOk && (sched_getaffinity(0, sizeof have, &have) == 0) &&
+                            CPU_EQUAL(&want, &have);
+    }
+
+    if (lockMemory)
+        report.memoryLockOk = memoryLocked();
+
+    if (prefaultStackBytes > 0)
+        report.stackOk = stackResident(prefaultStackBytes);
+
+    if (timerSlackNs >= 0)
+    {
+        long slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+        // 0 resets to the default slack. Otherwise the slack must be at most the request: recent kernels force it
+        // to 0 for SCHED_FIFO/SCHED_DEADLINE threads, which is even better
+        report.timerSlackOk = (timerSlackNs == 0) || (slack >= 0 && slack <= timerSlackNs);
+    }
+
+    return report;
+}
+
+/**
+ *@brief Check whether everything requested took effect
+ *@retval true All settings in effect
+ **/
+bool IcsRtReport::ok() const
+{
+    return schedulerOk && affinityOk && memoryLockOk && stackOk && timerSlackOk;
+}
+
+/**
+ *@brief Human readable one-line report
+ *@return e.g. "scheduler ok, affinity ok, mlockall FAILED (Operation not permitted), stack ok, timer slack ok"
+ **/
+std::string IcsRtReport::summary() const
+{
+    struct Item
+    {
+        const char *name;
+        bool ok;
+        int err;
+    } items[] = {{"scheduler", schedulerOk, schedulerErrno},
+                 {"affinity", affinityOk, affinityErrno},
+                 {"mlockall", memoryLockOk, memoryLockErrno},
+                 {"stack", stackOk, 0},
+                 {"timer slack", timerSlackOk, timerSlackErrno}};
+
+    std::string text;
+    for (const Item &item : items)
+    {
+        if (!text.empty())
+            text += ", ";
+        text += item.name;
+        if (item.ok)
+        {
+            text += " ok";
+            continue;
+        }
+        text += " FAILED";
+        if (item.err)
+        {
+            text += " (";
+            text += strerror(item.err);
+            text += ")";
+        }
+    }
+    return text;
+}
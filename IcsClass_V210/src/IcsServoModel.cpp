@@ -0,0 +1,114 @@
+/**
+ *@file IcsServoModel.cpp
+ *@brief Position, current and temperature response of an emulated servo
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cmath>
+#include "IcsServoModel.h"
+#include "IcsServoSim.h"
+
+/**
+ *@brief Put a servo at rest at its current position, at ambient temperature
+ *@param[in,out] &servo Servo state
+ **/
+void IcsServoModel::reset(IcsSimServo &servo) const
+{
+    servo.exactPos = servo.pos;
+    servo.velocity = 0.0;
+    servo.celsius = ambient;
+    servo.current = (unsigned char)std::lround(currentIdle);
+    servo.temperature = temperatureReadout(ambient);
+}
+
+/**
+ *@brief Advance a servo in time
+ *@param[in,out] &servo Servo state
+ *@param[in] dtNs Elapsed model time (ns)
+ **/
+void IcsServoModel::step(IcsSimServo &servo, long long dtNs) const
+{
+    if (order == MODEL_NONE || dtNs <= 0)
+        return;
+
+    while (dtNs > 0)
+    {
+        long long h = (dtNs > maxStepNs) ? maxStepNs : dtNs;
+        integrate(servo, h * 1e-9);
+        dtNs -= h;
+    }
+    servo.pos = (int)std::lround(servo.exactPos);
+}
+
+/**
+ *@brief Temperature readout of the servo for a motor temperature
+ *@param[in] celsius Temperature (deg C)
+ *@return Readout 1 to 127, lower is hotter (ambient 25 deg C reads 80)
+ **/
+int IcsServoModel::temperatureReadout(double celsius)
+{
+    long value = std::lround(105.0 - celsius);
+    if (value < 1)
+        return 1;
+    if (value > 127)
+        return 127;
+    return (int)value;
+}
+
+/**
+ *@brief One integration step
+ *@param[in,out] &servo Servo state
+ *@param[in] dt Step (s)
+ **/
+void IcsServoModel::integrate(IcsSimServo &servo, double dt) const
+{
+    double stiffness = servo.stretch / 127.0;
+    double vmax = maxSpeed * servo.speed / 127.0;
+    double error = servo.target - servo.exactPos;
+    double current = currentIdle;
+
+    if (servo.free)
+    {
+        servo.velocity = 0.0; // No drive, the horn stays where it was left
+    }
+    else if (order == MODEL_FIRST_ORDER)
+    {
+        servo.velocity = error * stiffness / timeConstant;
+    }
+    else
+    {
+        double w = naturalFreq * std::sqrt(stiffness);
+        servo.velocity += (w * w * error - 2.0 * damping * w * servo.velocity) * dt;
+    }
+
+    if (servo.velocity > vmax)
+        servo.velocity = vmax;
+    if (servo.velocity < -vmax)
+        servo.velocity = -vmax;
+
+    // Do not step past the command in the first order model
+    double move = servo.velocity * dt;
+    if (order == MODEL_FIRST_ORDER && std::fabs(move) > std::fabs(error))
+        move = error;
+    servo.exactPos += move;
+    if (servo.exactPos < 3500.0 || servo.exactPos > 11500.0) // Mechanical end stops
+    {
+        servo.exactPos = (servo.exactPos < 3500.0) ? 3500.0 : 11500.0;
+        servo.velocity = 0.0;
+    }
+
+    // The position loop pushes harder the further it is off, up to the current limit
+    if (!servo.free)
+        current += currentPerError * std::fabs(error) * stiffness;
+    if (current > servo.currentLimit)
+        current = servo.currentLimit;
+    if (current > 63.0)
+        current = 63.0;
+    servo.current = (unsigned char)std::lround(current);
+
+    servo.celsius += (heating * current * current - (servo.celsius - ambient) / coolingTime) * dt;
+    servo.temperature = temperatureReadout(servo.celsius);
+}
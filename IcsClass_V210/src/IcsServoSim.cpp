@@ -0,0 +1,743 @@
+/**
+ *@file IcsServoSim.cpp
+ *@brief ICS3.5/3.6 servo chain emulated behind a pseudo-terminal
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <iostream>
+#include <cerrno>
+#include <cmath>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "IcsServoSim.h"
+#include "IcsClock.h"
+
+/**
+ *@brief constructor
+ *@param[in] baudrate Emulated communication speed, only used for the reply timing
+ **/
+IcsServoSim::IcsServoSim(unsigned int baudrate)
+{
+    setBaudrate(baudrate);
+}
+
+/**
+ *@brief destructor
+ *@post The emulation thread is stopped and the pty is closed
+ **/
+IcsServoSim::~IcsServoSim()
+{
+    stop();
+    if (slave_fd >= 0)
+        close(slave_fd);
+    if (master_fd >= 0)
+        close(master_fd);
+}
+
+/**
+ *@brief Create the pseudo-terminal
+ *@retval true getDevice() can be opened now
+ *@retval false No pty available
+ **/
+bool IcsServoSim::open()
+{
+    if (master_fd >= 0)
+        return true;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0)
+    {
+        std::cerr << "Failed to create the simulator pty" << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    device = ptsname(fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // Keep one slave descriptor open, otherwise the master reads EIO whenever the library closes the port
+    slave_fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (slave_fd < 0)
+    {
+        std::cerr << "Failed to open the simulator pty slave " << device << std::endl;
+        close(fd);
+        return false;
+    }
+    struct termios raw;
+    if (tcgetattr(slave_fd, &raw) == 0)
+    {
+        cfmakeraw(&raw);
+        tcsetattr(slave_fd, TCSANOW, &raw);
+    }
+
+    master_fd = fd;
+    return true;
+}
+
+/**
+ *@brief Serial device to hand to IcsHardSerialClass
+ *@return Slave path (e.g. /dev/pts/3), empty before open()
+ **/
+const char *IcsServoSim::getDevice() const
+{
+    return device.c_str();
+}
+
+/**
+ *@brief Start answering commands in a background thread
+ *@retval true Running
+ *@retval false The pty could not be created
+ **/
+bool IcsServoSim::start()
+{
+    if (!open())
+        return false;
+    if (running.exchange(true))
+        return true;
+    thread = std::thread(&IcsServoSim::emulationLoop, this);
+    return true;
+}
+
+/**
+ *@brief Stop answering
+ **/
+void IcsServoSim::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+/**
+ *@brief Connect a servo to the chain
+ *@param[in] id Servo ID (0-31), may repeat to emulate an ID conflict
+ *@param[in] pos Initial position
+ **/
+void IcsServoSim::addServo(unsigned char id, int pos)
+{
+    IcsSimServo servo;
+    servo.id = id & 0x1F;
+    servo.pos = pos;
+    servo.target = pos;
+
+    std::lock_guard<std::mutex> guard(lock);
+    model_default.reset(servo);
+    servos.push_back(servo);
+}
+
+/**
+ *@brief Connect servos with IDs 0 to count-1
+ *@param[in] count Number of servos (up to 32)
+ **/
+void IcsServoSim::addServos(int count)
+{
+    for (int id = 0; id < count && id < 32; id++)
+        addServo(id);
+}
+
+/**
+ *@brief Disconnect the first servo with an ID
+ *@param[in] id Servo ID
+ *@retval true Removed
+ *@retval false No such servo
+ **/
+bool IcsServoSim::removeServo(unsigned char id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < servos.size(); i++)
+    {
+        if (servos[i].id == id)
+        {
+            servos.erase(servos.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *@brief Copy the state of the first servo with an ID, brought up to the current model time
+ *@param[in] id Servo ID
+ *@param[out] &servo State
+ *@retval false No such servo
+ **/
+bool IcsServoSim::getServo(unsigned char id, IcsSimServo &servo)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    updateModel();
+    for (size_t i = 0; i < servos.size(); i++)
+    {
+        if (servos[i].id == id)
+        {
+            servo = servos[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *@brief Overwrite the state of the first servo with the same ID (e.g. to inject a temperature)
+ *@param[in] &servo New state
+ *@retval false No such servo
+ **/
+bool IcsServoSim::setServo(const IcsSimServo &servo)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < servos.size(); i++)
+    {
+        if (servos[i].id == servo.id)
+        {
+            servos[i] = servo;
+            if (std::lround(servo.exactPos) != servo.pos) // pos was edited, move the model there
+                servos[i].exactPos = servo.pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ *@brief Number of servos on the chain
+ *@return Servo count
+ **/
+int IcsServoSim::getServoCount() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return (int)servos.size();
+}
+
+/**
+ *@brief Change the emulated communication speed
+ *@param[in] baudrate Baud rate the reply timing is derived from
+ **/
+void IcsServoSim::setBaudrate(unsigned int baudrate)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    timing_default = IcsTimingModel(baudrate);
+    frame_gap_ns = IcsClock::NS_PER_MS + 10LL * timing_default.charNs();
+}
+
+/**
+ *@brief Get the emulated communication speed
+ *@return Baud rate
+ **/
+unsigned int IcsServoSim::getBaudrate() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return timing_default.getBaudrate();
+}
+
+/**
+ *@brief Set the time a servo needs between the end of a command and the start of its reply
+ *@param[in] ns Turnaround (ns)
+ **/
+void IcsServoSim::setTurnaround(long long ns)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    turnaround_ns = ns;
+}
+
+/**
+ *@brief Get the servo turnaround
+ *@return Turnaround (ns)
+ **/
+long long IcsServoSim::getTurnaround() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return turnaround_ns;
+}
+
+/**
+ *@brief Choose how reply bytes are handed out
+ *@param[in] enable true: one character time apart like a UART (default), false: the whole reply at its end time
+ **/
+void IcsServoSim::setPaced(bool enable)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    paced = enable;
+}
+
+/**
+ *@brief Change the dynamics of the servos
+ *@param[in] &model Model parameters (order MODEL_NONE: positions jump to the command)
+ **/
+void IcsServoSim::setModel(const IcsServoModel &model)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    updateModel();
+    model_default = model;
+}
+
+/**
+ *@brief Get the dynamics of the servos
+ *@return Model parameters
+ **/
+IcsServoModel IcsServoSim::getModel() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return model_default;
+}
+
+/**
+ *@brief Run the model faster (or slower) than the wall clock
+ *@param[in] scale Model seconds per wall clock second (e.g. 10: a 1 s trajectory is over after 100 ms)
+ **/
+void IcsServoSim::setTimeScale(double scale)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    updateModel();
+    time_scale = scale;
+}
+
+/**
+ *@brief Decouple the model from the wall clock
+ *@param[in] enable true: model time only moves with advance(), so a controller can be run as fast as the bus allows
+ **/
+void IcsServoSim::setManualClock(bool enable)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    updateModel();
+    manual_clock = enable;
+}
+
+/**
+ *@brief Step the model by hand (manual clock)
+ *@param[in] ns Model time to add (ns)
+ **/
+void IcsServoSim::advance(long long ns)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!manual_clock || ns <= 0)
+        return;
+    model_time_ns += ns;
+    for (size_t i = 0; i < servos.size(); i++)
+        model_default.step(servos[i], ns);
+}
+
+/**
+ *@brief Get the model time
+ *@return Model time since the simulator was created (ns)
+ **/
+long long IcsServoSim::getModelTimeNs() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return model_time_ns;
+}
+
+/**
+ *@brief Bring every servo up to the current model time
+ *@note Called with the lock held. Does nothing with the manual clock, advance() moves the model then.
+ **/
+void IcsServoSim::updateModel()
+{
+    long long now = IcsClock::nowNs();
+    long long dt = (long long)((now - model_wall_ns) * time_scale);
+
+    if (model_wall_ns == 0 || manual_clock)
+        dt = 0;
+    model_wall_ns = now;
+    if (dt <= 0)
+        return;
+
+    model_time_ns += dt;
+    for (size_t i = 0; i < servos.size(); i++)
+        model_default.step(servos[i], dt);
+}
+
+/**
+ *@brief Select the faults to inject and restart the fault generator
+ *@param[in] &faults Fault probabilities and seed (all zero: a perfect bus)
+ **/
+void IcsServoSim::setFaults(const IcsSimFaults &faults)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    faults_default = faults;
+    rng_default.seed(faults.seed);
+}
+
+/**
+ *@brief Get the faults being injected
+ *@return Fault configuration
+ **/
+IcsSimFaults IcsServoSim::getFaults() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return faults_default;
+}
+
+/**
+ *@brief Get the counters
+ *@return Copy of the counters
+ **/
+IcsSimStats IcsServoSim::getStats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stats_default;
+}
+
+/**
+ *@brief Clear the counters
+ **/
+void IcsServoSim::resetStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    stats_default = IcsSimStats();
+}
+
+/**
+ *@brief Length of the command that starts with a byte
+ *@param[in] cmd First byte
+ *@return Command length in bytes, 0 if the byte cannot start a command
+ **/
+int IcsServoSim::frameLength(unsigned char cmd)
+{
+    switch (cmd & 0xE0)
+    {
+    case 0x80: // Position
+        return 3;
+    case 0xA0: // Read
+        return 2;
+    case 0xC0: // Write
+        return 3;
+    case 0xE0: // ID read/write
+        return 4;
+    default: // Bit 7 clear: reply data or noise
+        return 0;
+    }
+}
+
+/**
+ *@brief Body of the emulation thread: frame the commands, answer them on time
+ **/
+void IcsServoSim::emulationLoop()
+{
+    unsigned char frame[4];
+    unsigned char reply[256];
+    bool lost[256];
+    unsigned char chunk[64];
+    int have = 0;
+    int need = 0;
+    long long firstNs = 0;
+    long long lastNs = 0;
+
+    while (running)
+    {
+        struct pollfd pfd;
+        pfd.fd = master_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        long long gap;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            gap = frame_gap_ns;
+        }
+        // Wake up for stop() now and then, and for the gap that aborts a partial command
+        long long waitNs = 20 * IcsClock::NS_PER_MS;
+        if (have > 0 && lastNs + gap - IcsClock::nowNs() < waitNs)
+            waitNs = lastNs + gap - IcsClock::nowNs();
+        struct timespec ts = IcsClock::toTimespec(waitNs);
+        int ret = ppoll(&pfd, 1, &ts, NULL);
+
+        long long now = IcsClock::nowNs();
+        if (have > 0 && now - lastNs > gap)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stats_default.brokenFrames++;
+            have = 0;
+        }
+        if (ret <= 0 || !(pfd.revents & POLLIN))
+            continue;
+
+        ssize_t n = read(master_fd, chunk, sizeof chunk);
+        if (n <= 0)
+            continue;
+
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (have == 0)
+            {
+                need = frameLength(chunk[i]);
+                if (need == 0)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    stats_default.garbageBytes++;
+                    continue;
+                }
+                firstNs = now;
+            }
+            frame[have++] = chunk[i];
+            lastNs = now;
+            if (have < need)
+                continue;
+            have = 0;
+
+            int replyLen;
+            long long startNs;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stats_default.frames++;
+                updateModel();
+                replyLen = answer(frame, need, reply);
+                if (replyLen == 0)
+                    stats_default.unanswered++;
+
+                // The last command byte arrives one wire time after the first on a real bus
+                startNs = firstNs + timing_default.wireNs(need);
+                if (startNs < now)
+                    startNs = now;
+                startNs += turnaround_ns;
+                startNs = injectFaults(reply, lost, replyLen, startNs);
+            }
+            if (replyLen > 0)
+                sendReply(reply, lost, replyLen, startNs);
+        }
+    }
+}
+
+/**
+ *@brief Build the replies of all servos addressed by a command
+ *@param[in] *rxBuf Complete command
+ *@param[in] rxLen Command length
+ *@param[out] *txBuf Replies, one after the other in chain order (room for 256 bytes)
+ *@return Number of reply bytes (0: nobody answers)
+ *@note Called with the lock held.
+ *@note An ID read is answered by every servo on the chain. On a real bus these replies would collide.
+ **/
+int IcsServoSim::answer(const unsigned char *rxBuf, int rxLen, unsigned char *txBuf)
+{
+    int len = 0;
+    unsigned char cmd = rxBuf[0] & 0xE0;
+    unsigned char id = rxBuf[0] & 0x1F;
+    (void)rxLen;
+
+    for (size_t i = 0; i < servos.size(); i++)
+    {
+        IcsSimServo &servo = servos[i];
+        bool idWrite = (cmd == 0xE0) && rxBuf[1] == 1 && rxBuf[2] == 1 && rxBuf[3] == 1;
+        bool idRead = (rxBuf[0] == 0xFF) && rxBuf[1] == 0 && rxBuf[2] == 0 && rxBuf[3] == 0;
+        int n;
+
+        // ID commands reach every servo on the chain, the others only the addressed ones
+        if ((cmd == 0xE0) ? !(idWrite || idRead) : (servo.id != id))
+            continue;
+
+        // A silent servo neither answers nor executes
+        if (((faults_default.silentMask >> servo.id) & 1) || chance(faults_default.silent))
+        {
+            stats_default.silences++;
+            continue;
+        }
+
+        if (cmd == 0xE0)
+        {
+            if (idWrite)
+                servo.id = id;
+            txBuf[len] = 0xE0 | servo.id;
+            n = 1;
+        }
+        else
+        {
+            n = answerServo(servo, rxBuf, txBuf + len);
+        }
+        if (n == 0)
+            continue;
+        stats_default.replies++;
+
+        // Phantom second servo with the same ID
+        if (len + 2 * n <= 256 && chance(faults_default.duplicateReply))
+        {
+            for (int k = 0; k < n; k++)
+                txBuf[len + n + k] = txBuf[len + k];
+            stats_default.duplicates++;
+            n *= 2;
+        }
+        len += n;
+    }
+    return len;
+}
+
+/**
+ *@brief Execute a position, read or write command on one servo
+ *@param[in,out] &servo Addressed servo
+ *@param[in] *rxBuf Complete command
+ *@param[out] *txBuf Reply
+ *@return Reply length (0: the servo stays silent)
+ **/
+int IcsServoSim::answerServo(IcsSimServo &servo, const unsigned char *rxBuf, unsigned char *txBuf)
+{
+    unsigned char cmd = rxBuf[0] & 0xE0;
+    unsigned char sc = rxBuf[1];
+
+    txBuf[0] = rxBuf[0] & 0x7F;
+
+    if (cmd == 0x80)
+    {
+        // The reply carries the position before the command
+        txBuf[1] = (servo.pos >> 7) & 0x7F;
+        txBuf[2] = servo.pos & 0x7F;
+
+        int pos = ((rxBuf[1] & 0x7F) << 7) | (rxBuf[2] & 0x7F);
+        if (pos == 0)
+        {
+            servo.free = true;
+        }
+        else
+        {
+            servo.free = false;
+            servo.target = pos;
+            if (model_default.order == IcsServoModel::MODEL_NONE)
+            {
+                servo.pos = pos;
+                servo.exactPos = pos;
+            }
+        }
+        return 3;
+    }
+
+    txBuf[1] = sc;
+
+    if (cmd == 0xA0)
+    {
+        switch (sc)
+        {
+        case 0x01:
+            txBuf[2] = servo.stretch;
+            return 3;
+        case 0x02:
+            txBuf[2] = servo.speed;
+            return 3;
+        case 0x03:
+            txBuf[2] = servo.current;
+            return 3;
+        case 0x04:
+            txBuf[2] = servo.temperature;
+            return 3;
+        case 0x05:
+            txBuf[2] = (servo.pos >> 7) & 0x7F;
+            txBuf[3] = servo.pos & 0x7F;
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    // Write: the reply echoes the value
+    unsigned char value = rxBuf[2];
+    switch (sc)
+    {
+    case 0x01:
+        servo.stretch = value;
+        break;
+    case 0x02:
+        servo.speed = value;
+        break;
+    case 0x03:
+        servo.currentLimit = value;
+        break;
+    case 0x04:
+        servo.tmpLimit = value;
+        break;
+    default:
+        return 0;
+    }
+    txBuf[2] = value;
+    return 3;
+}
+
+/**
+ *@brief Draw from the fault generator
+ *@param[in] p Probability (0 to 1)
+ *@retval true The fault happens
+ *@note Nothing is drawn for a probability of 0.
+ **/
+bool IcsServoSim::chance(double p)
+{
+    if (p <= 0.0)
+        return false;
+    return rng_default() < p * 4294967296.0;
+}
+
+/**
+ *@brief Corrupt a reply according to the configured faults
+ *@param[in,out] *txBuf Reply bytes
+ *@param[out] *lost Per byte: true if it must not reach the receiver
+ *@param[in] txLen Number of bytes
+ *@param[in] startNs Scheduled start of the reply (ns)
+ *@return Start of the reply after the late reply fault (ns)
+ *@note Called with the lock held.
+ **/
+long long IcsServoSim::injectFaults(unsigned char *txBuf, bool *lost, int txLen, long long startNs)
+{
+    if (txLen > 0 && chance(faults_default.lateReply))
+    {
+        startNs += faults_default.lateDelayNs;
+        stats_default.lateReplies++;
+    }
+
+    for (int i = 0; i < txLen; i++)
+    {
+        lost[i] = false;
+        if (chance(faults_default.byteLoss))
+        {
+            lost[i] = true;
+            stats_default.lostBytes++;
+        }
+        else if (chance(faults_default.parityError))
+        {
+            lost[i] = true;
+            stats_default.parityErrors++;
+        }
+        else if (chance(faults_default.bitFlip))
+        {
+            txBuf[i] ^= 1 << (rng_default() & 7);
+            stats_default.flippedBytes++;
+        }
+    }
+    return startNs;
+}
+
+/**
+ *@brief Put a reply on the "wire" at the time a UART would deliver it
+ *@param[in] *txBuf Reply bytes
+ *@param[in] *lost Per byte: true if it is lost on the way (its time slot still passes)
+ *@param[in] txLen Number of bytes
+ *@param[in] startNs Time the start bit of the first byte goes out (ns)
+ **/
+void IcsServoSim::sendReply(const unsigned char *txBuf, const bool *lost, int txLen, long long startNs)
+{
+    long long charNs;
+    bool pace;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        charNs = timing_default.charNs();
+        pace = paced;
+    }
+
+    unsigned char out[256];
+    int outLen = 0;
+
+    for (int i = 0; i < txLen; i++)
+    {
+        if (!lost[i])
+            out[outLen++] = txBuf[i];
+
+        // A received byte is readable once its stop bit is in
+        if (outLen == 0 || (!pace && i < txLen - 1))
+            continue;
+        struct timespec ts = IcsClock::toTimespec(startNs + (long long)(i + 1) * charNs);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        if (write(master_fd, out, outLen) != outLen)
+            return;
+        outLen = 0;
+    }
+}
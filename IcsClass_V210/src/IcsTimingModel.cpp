@@ -0,0 +1,79 @@
+/**
+ *@file IcsTimingModel.cpp
+ *@brief Wire timing of ICS transactions derived from the baud rate
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsTimingModel.h"
+
+/**
+ *@brief constructor
+ *@param[in] baudrate Servo communication speed (0 is treated as 115200)
+ **/
+IcsTimingModel::IcsTimingModel(unsigned int baudrate)
+{
+    if (baudrate > 0)
+        baudrate_default = baudrate;
+}
+
+/**
+ *@brief Get the baud rate the model was built for
+ *@return Baud rate
+ **/
+unsigned int IcsTimingModel::getBaudrate() const
+{
+    return baudrate_default;
+}
+
+/**
+ *@brief Duration of one bit, rounded up
+ *@return Bit time (ns)
+ **/
+unsigned int IcsTimingModel::bitNs() const
+{
+    return (1000000000ULL + baudrate_default - 1) / baudrate_default;
+}
+
+/**
+ *@brief Duration of one character, rounded up
+ *@return Character time (ns)
+ **/
+unsigned int IcsTimingModel::charNs() const
+{
+    return wireNs(1);
+}
+
+/**
+ *@brief Time needed to shift a number of back-to-back characters
+ *@param[in] chars Number of characters
+ *@return Wire time (ns), rounded up
+ **/
+unsigned int IcsTimingModel::wireNs(unsigned int chars) const
+{
+    unsigned long long bits = (unsigned long long)chars * BITS_PER_CHAR;
+    return (bits * 1000000000ULL + baudrate_default - 1) / baudrate_default;
+}
+
+/**
+ *@brief Timing of a command of txLen bytes answered with rxLen bytes
+ *@param[in] txLen Number of bytes sent
+ *@param[in] rxLen Number of bytes expected back
+ *@return Expected durations of the exchange
+ *@note write() returns as soon as the bytes are queued, so the first character may still be in the FIFO.
+ *      txSleepNs stops one character short of the end of the command so the last stop bit is never missed,
+ *      txReleaseNs adds one bit of margin for drivers that cannot report an empty transmitter.
+ **/
+IcsTransactionTiming IcsTimingModel::transaction(unsigned char txLen, unsigned char rxLen) const
+{
+    IcsTransactionTiming t;
+    t.bitNs = bitNs();
+    t.charNs = charNs();
+    t.txWireNs = wireNs(txLen);
+    t.rxWireNs = wireNs(rxLen);
+    t.txSleepNs = (txLen > 1) ? wireNs(txLen - 1) : 0;
+    t.txReleaseNs = t.txWireNs + t.bitNs;
+    return t;
+}
@@ -0,0 +1,677 @@
+/**
+ *@file IcsTopology.cpp
+ *@brief Robot description file: buses, joints, servo models and timing
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "IcsBusHub.h"
+#include "IcsHardSerialClass.h"
+#include "IcsTopology.h"
+
+namespace
+{
+  const float DEG_TO_RAD = 3.14159265f / 180.0f;
+
+  std::string trim(const std::string &text)
+  {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+      return "";
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+  }
+
+  bool toInt(const std::string &text, int &value)
+  {
+    if (text.empty())
+      return false;
+    char *end;
+    errno = 0;
+    long v = strtol(text.c_str(), &end, 10); // Decimal only: a leading zero (enpin = 07) is not octal
+    if (*end != 0 || errno != 0 || v < -2147483647L || v > 2147483647L)
+      return false;
+    value = (int)v;
+    return true;
+  }
+
+  bool toFloat(const std::string &text, float &value)
+  {
+    if (text.empty())
+      return false;
+    char *end;
+    errno = 0;
+    value = strtof(text.c_str(), &end);
+    return *end == 0 && errno == 0;
+  }
+}
+
+/**
+ *@brief constructor, an empty robot
+ **/
+IcsTopology::IcsTopology()
+{
+}
+
+/**
+ *@brief Read a topology file
+ *@param[in] *path File name
+ *@return false if the file cannot be read or is invalid (the topology is then empty)
+ *@note A relative calibration file name is taken relative to the directory of the topology file.
+ **/
+bool IcsTopology::load(const char *path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Topology: unable to open " << path << std::endl;
+        clear();
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!parse(text.str(), path))
+        return false;
+
+    std::string dir(path);
+    size_t slash = dir.rfind('/');
+    if (!calibration_file.empty() && calibration_file[0] != '/' && slash != std::string::npos)
+        calibration_file = dir.substr(0, slash + 1) + calibration_file;
+    return true;
+}
+
+/**
+ *@brief Read a topology from text
+ *@param[in] &text Contents of a topology file
+ *@param[in] *source Name used in error messages
+ *@return false if a line is invalid or a name does not resolve (the topology is then empty)
+ **/
+bool IcsTopology::parse(const std::string &text, const char *source)
+{
+    clear();
+    std::istringstream in(text);
+    std::string line, section, error;
+    int lineNo = 0;
+    while (std::getline(in, line))
+    {
+        lineNo++;
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty())
+            continue;
+
+        if (line[0] == '[')
+        {
+            if (line[line.size() - 1] != ']')
+                error = "']' expected";
+            else
+            {
+                section = trim(line.substr(1, line.size() - 2));
+                std::string type = section.substr(0, section.find('.'));
+                std::string name = (type.size() < section.size()) ? section.substr(type.size() + 1) : "";
+                if (section == "robot")
+                    continue;
+                if (name.empty() || (type != "bus" && type != "model" && type != "joint"))
+                    error = "unknown section [" + section + "]";
+                else if ((type == "bus" && findBus(name) >= 0) || (type == "model" && findModel(name) >= 0) ||
+                         (type == "joint" && findJoint(name) >= 0))
+                    error = "duplicate section [" + section + "]";
+                else if (type == "bus")
+                {
+                    IcsTopologyBus bus;
+                    bus.name = name;
+                    buses.push_back(bus);
+                    bus_models.push_back("");
+                }
+                else if (type == "model")
+                {
+                    IcsTopologyModel model;
+                    model.name = name;
+                    models.push_back(model);
+                }
+                else
+                {
+                    IcsTopologyJoint joint;
+                    joint.name = name;
+                    joints.push_back(joint);
+                    joint_buses.push_back("");
+                    joint_models.push_back("");
+                    joint_mirrors.push_back("");
+                    joint_shapes.push_back(false);
+                }
+            }
+        }
+        else
+        {
+            size_t equal = line.find('=');
+            if (section.empty())
+                error = "key outside a section";
+            else if (equal == std::string::npos)
+                error = "'=' expected";
+            else
+                setKey(section, trim(line.substr(0, equal)), trim(line.substr(equal + 1)), error);
+        }
+
+        if (!error.empty())
+        {
+            std::cerr << "Topology: " << source << ":" << lineNo << ": " << error << std::endl;
+            clear();
+            return false;
+        }
+
+        // Buses and joints declared by this line
+        bus_lines.resize(buses.size(), lineNo);
+        joint_lines.resize(joints.size(), lineNo);
+    }
+
+    if (!resolve(error, lineNo))
+    {
+        std::cerr << "Topology: " << source << ":" << lineNo << ": " << error << std::endl;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ *@brief Get the number of buses
+ *@return Number of buses
+ **/
+int IcsTopology::getBusCount() const
+{
+    return (int)buses.size();
+}
+
+/**
+ *@brief Get the number of joints
+ *@return Number of joints
+ **/
+int IcsTopology::getJointCount() const
+{
+    return (int)joints.size();
+}
+
+/**
+ *@brief Get the number of servo models
+ *@return Number of models
+ **/
+int IcsTopology::getModelCount() const
+{
+    return (int)models.size();
+}
+
+/**
+ *@brief Get a bus
+ *@param[in] bus Bus index (must exist)
+ *@return Bus description
+ **/
+const IcsTopologyBus &IcsTopology::getBus(int bus) const
+{
+    return buses[bus];
+}
+
+/**
+ *@brief Get a joint
+ *@param[in] joint Joint index (must exist)
+ *@return Joint description
+ **/
+const IcsTopologyJoint &IcsTopology::getJoint(int joint) const
+{
+    return joints[joint];
+}
+
+/**
+ *@brief Get a servo model
+ *@param[in] model Model index (must exist)
+ *@return Model description
+ **/
+const IcsTopologyModel &IcsTopology::getModel(int model) const
+{
+    return models[model];
+}
+
+/**
+ *@brief Find a bus by name
+ *@param[in] &name Name after "bus."
+ *@return Bus index
+ *@retval -1 No such bus
+ **/
+int IcsTopology::findBus(const std::string &name) const
+{
+    for (int b = 0; b < getBusCount(); b++)
+        if (buses[b].name == name)
+            return b;
+    return -1;
+}
+
+/**
+ *@brief Find a joint by name
+ *@param[in] &name Name after "joint.", or "bus.id" for joints of an ids list
+ *@return Joint index
+ *@retval -1 No such joint
+ **/
+int IcsTopology::findJoint(const std::string &name) const
+{
+    for (int j = 0; j < getJointCount(); j++)
+        if (joints[j].name == name)
+            return j;
+    return -1;
+}
+
+/**
+ *@brief Find a servo model by name
+ *@param[in] &name Name after "model."
+ *@return Model index
+ *@retval -1 No such model
+ **/
+int IcsTopology::findModel(const std::string &name) const
+{
+    for (int m = 0; m < getModelCount(); m++)
+        if (models[m].name == name)
+            return m;
+    return -1;
+}
+
+/**
+ *@brief Baud rate of a bus
+ *@param[in] bus Bus index (must exist)
+ *@return The bus baudrate, else the [robot] baudrate
+ **/
+unsigned int IcsTopology::getBaudrate(int bus) const
+{
+    return buses[bus].baudrate ? buses[bus].baudrate : baudrate_default;
+}
+
+/**
+ *@brief Reply timeout of a bus
+ *@param[in] bus Bus index (must exist)
+ *@return The bus timeout, else the [robot] timeout (ms)
+ **/
+int IcsTopology::getTimeout(int bus) const
+{
+    return (buses[bus].timeout >= 0) ? buses[bus].timeout : timeout_default;
+}
+
+/**
+ *@brief Enable pin of a bus
+ *@param[in] bus Bus index (must exist)
+ *@return The bus enpin, else the PCB pin of its UART (BCM numbering)
+ *@retval -1 Neither is known
+ **/
+int IcsTopology::getEnablePin(int bus) const
+{
+    return (buses[bus].enpin >= 0) ? buses[bus].enpin : IcsHardSerialClass::defaultEnablePin(buses[bus].device.c_str());
+}
+
+/**
+ *@brief Level shifter enable pin
+ *@return [robot] oe_pin (BCM numbering)
+ *@retval -1 None
+ **/
+int IcsTopology::getOePin() const
+{
+    return oe_pin;
+}
+
+/**
+ *@brief Open every bus and register every joint, in file order
+ *@param[in] &hub Empty hub
+ *@return false if the hub is not empty or a bus has no enable pin (nothing is added then)
+ *@note Drives oe_pin high first when it is set. Timing and direction overrides go to the IcsHardSerialClass of each
+ *      bus; an RS-485 mode the driver refuses is reported and the bus stays on GPIO direction control.
+ **/
+bool IcsTopology::build(IcsBusHub &hub) const
+{
+    if (hub.getBusCount() != 0 || hub.getJointCount() != 0)
+    {
+        std::cerr << "Topology: the hub already has buses" << std::endl;
+        return false;
+    }
+    for (int b = 0; b < getBusCount(); b++)
+    {
+        if (getEnablePin(b) < 0)
+        {
+            std::cerr << "Topology: bus " << buses[b].name << " has no enpin and " << buses[b].device
+                      << " is not one of /dev/ttyAMA0-4" << std::endl;
+            return false;
+        }
+    }
+
+    if (oe_pin >= 0)
+    {
+        // uses BCM numbering of the GPIOs and directly accesses the GPIO registers.
+        if (wiringPiSetupGpio() == -1)
+        {
+            std::cerr << "Topology: error initialising wiringPi GPIO" << std::endl;
+            return false;
+        }
+        pinMode(oe_pin, OUTPUT);
+        digitalWrite(oe_pin, HIGH);
+        delay(100);
+    }
+
+    for (int b = 0; b < getBusCount(); b++)
+    {
+        const IcsTopologyBus &bus = buses[b];
+        hub.addBus(bus.device.c_str(), getEnablePin(b), getBaudrate(b), getTimeout(b));
+
+        IcsHardSerialClass *serial = dynamic_cast<IcsHardSerialClass *>(&hub.getBus(b));
+        if (!serial)
+            continue;
+        if (bus.interByteTimeoutUs >= 0)
+            serial->setInterByteTimeout(bus.interByteTimeoutUs);
+        if (bus.rxMode >= 0)
+            serial->setRxMode((IcsHardSerialClass::RxMode)bus.rxMode);
+        if (bus.dirMode == IcsHardSerialClass::DIR_MODE_RS485 && !serial->setRs485Mode())
+            std::cerr << "Topology: bus " << bus.name << " stays on GPIO direction control" << std::endl;
+    }
+
+    for (int j = 0; j < getJointCount(); j++)
+        hub.addJoint(joints[j].bus, joints[j].id);
+    return true;
+}
+
+/**
+ *@brief Fill a calibration table in hub joint order
+ *@param[in] &calibration Table, resized to the joint count
+ *@return false if the calibration file cannot be read or does not match the joint count
+ *@note The [robot] calibration file is applied first, then the joints whose sections set offset, sign, gear or limits,
+ *      then the mirrors (IcsCalibration::mirror() of the joint as calibrated so far, with the mirror's own offset).
+ **/
+bool IcsTopology::buildCalibration(IcsCalibration &calibration) const
+{
+    calibration.resize(0);
+    calibration.resize(getJointCount());
+    if (!calibration_file.empty())
+    {
+        if (!calibration.load(calibration_file.c_str()))
+            return false;
+        if (calibration.getJointCount() != getJointCount())
+        {
+            std::cerr << "Topology: " << calibration_file << " has " << calibration.getJointCount() << " joints, expected "
+                      << getJointCount() << std::endl;
+            return false;
+        }
+    }
+
+    bool ok = true;
+    for (int j = 0; j < getJointCount(); j++)
+        if (joints[j].calibrated && joints[j].mirror < 0)
+            ok = calibration.setJoint(j, joints[j].calibration) && ok;
+
+    // In joint order, so a mirror of a mirror sees the final calibration of the joint above it
+    for (int j = 0; j < getJointCount(); j++)
+        if (joints[j].mirror >= 0)
+            ok = calibration.mirror(j, joints[j].mirror, joints[j].calibration.offset) && ok;
+    return ok;
+}
+
+/**
+ *@brief Write the model settings (stretch, speed, current and temperature limits) to every servo that has a model
+ *@param[in] &hub Hub built by build()
+ *@return Number of writes the servos did not acknowledge
+ *@attention Run before the first whole-robot call, the writes go straight to the buses from the calling thread.
+ **/
+int IcsTopology::applyModels(IcsBusHub &hub) const
+{
+    int failed = 0;
+    for (int j = 0; j < getJointCount(); j++)
+    {
+        const IcsTopologyJoint &joint = joints[j];
+        if (joint.model < 0)
+            continue;
+        const IcsTopologyModel &model = models[joint.model];
+        IcsBaseClass &bus = hub.getBus(joint.bus);
+        if (model.stretch >= 0 && bus.setStrc(joint.id, model.stretch) == IcsBaseClass::ICS_FALSE)
+            failed++;
+        if (model.speed >= 0 && bus.setSpd(joint.id, model.speed) == IcsBaseClass::ICS_FALSE)
+            failed++;
+        if (model.currentLimit >= 0 && bus.setCur(joint.id, model.currentLimit) == IcsBaseClass::ICS_FALSE)
+            failed++;
+        if (model.temperatureLimit >= 0 && bus.setTmp(joint.id, model.temperatureLimit) == IcsBaseClass::ICS_FALSE)
+            failed++;
+    }
+    return failed;
+}
+
+/**
+ *@brief Forget everything, back to an empty robot with the default [robot] values
+ **/
+void IcsTopology::clear()
+{
+    baudrate_default = 115200;
+    timeout_default = 100;
+    oe_pin = -1;
+    calibration_file.clear();
+    buses.clear();
+    models.clear();
+    joints.clear();
+    bus_models.clear();
+    joint_buses.clear();
+    joint_models.clear();
+    joint_mirrors.clear();
+    joint_shapes.clear();
+    bus_lines.clear();
+    joint_lines.clear();
+}
+
+/**
+ *@brief Store one key of the current section
+ *@param[in] &section Section name, e.g. "bus.LL" (the last one of its type)
+ *@param[in] &key Key
+ *@param[in] &value Value
+ *@param[out] &error Message when the key is unknown or the value invalid
+ *@return false on error
+ **/
+bool IcsTopology::setKey(const std::string &section, const std::string &key, const std::string &value, std::string &error)
+{
+    int number = 0;
+    float real = 0.0f;
+    bool isInt = toInt(value, number);
+    bool isFloat = toFloat(value, real);
+    error = "invalid value for " + key;
+
+    if (section == "robot")
+    {
+        if (key == "baudrate" && isInt && number > 0)
+            baudrate_default = number;
+        else if (key == "timeout" && isInt && number >= 0)
+            timeout_default = number;
+        else if (key == "oe_pin" && isInt && number >= 0)
+            oe_pin = number;
+        else if (key == "calibration" && !value.empty())
+            calibration_file = value;
+        else
+        {
+            if (key != "baudrate" && key != "timeout" && key != "oe_pin" && key != "calibration")
+                error = "unknown key " + key + " in [robot]";
+            return false;
+        }
+    }
+    else if (section.compare(0, 4, "bus.") == 0)
+    {
+        IcsTopologyBus &bus = buses.back();
+        if (key == "device" && !value.empty())
+            bus.device = value;
+        else if (key == "enpin" && isInt && number >= 0 && number < 256)
+            bus.enpin = number;
+        else if (key == "baudrate" && isInt && number > 0)
+            bus.baudrate = number;
+        else if (key == "timeout" && isInt && number >= 0)
+            bus.timeout = number;
+        else if (key == "interbyte_timeout_us" && isInt && number >= 0)
+            bus.interByteTimeoutUs = number;
+        else if (key == "rx_mode" && (value == "spin" || value == "poll"))
+            bus.rxMode = (value == "spin") ? IcsHardSerialClass::RX_MODE_SPIN : IcsHardSerialClass::RX_MODE_POLL;
+        else if (key == "dir_mode" && (value == "gpio" || value == "rs485"))
+            bus.dirMode = (value == "gpio") ? IcsHardSerialClass::DIR_MODE_GPIO : IcsHardSerialClass::DIR_MODE_RS485;
+        else if (key == "model" && !value.empty())
+            bus_models.back() = value;
+        else if (key == "ids")
+        {
+            // One joint per ID, named "bus.id", in the order listed
+            std::istringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ','))
+            {
+                int id;
+                if (!toInt(trim(item), id) || id < 0 || id > 31)
+                    return false;
+                IcsTopologyJoint joint;
+                joint.name = bus.name + "." + std::to_string(id);
+                joint.id = id;
+                if (findJoint(joint.name) >= 0)
+                {
+                    error = "ID " + std::to_string(id) + " listed twice";
+                    return false;
+                }
+                joints.push_back(joint);
+                joint_buses.push_back(bus.name);
+                joint_models.push_back("");
+                joint_mirrors.push_back("");
+                joint_shapes.push_back(false);
+            }
+        }
+        else
+        {
+            if (key != "device" && key != "enpin" && key != "baudrate" && key != "timeout" &&
+                key != "interbyte_timeout_us" && key != "rx_mode" && key != "dir_mode" && key != "model")
+                error = "unknown key " + key + " in [" + section + "]";
+            return false;
+        }
+    }
+    else if (section.compare(0, 6, "model.") == 0)
+    {
+        IcsTopologyModel &model = models.back();
+        if (key == "stretch" && isInt && number >= 1 && number <= 127)
+            model.stretch = number;
+        else if (key == "speed" && isInt && number >= 1 && number <= 127)
+            model.speed = number;
+        else if (key == "current_limit" && isInt && number >= 1 && number <= 63)
+            model.currentLimit = number;
+        else if (key == "temperature_limit" && isInt && number >= 1 && number <= 127)
+            model.temperatureLimit = number;
+        else
+        {
+            if (key != "stretch" && key != "speed" && key != "current_limit" && key != "temperature_limit")
+                error = "unknown key " + key + " in [" + section + "]";
+            return false;
+        }
+    }
+    else
+    {
+        IcsTopologyJoint &joint = joints.back();
+        IcsJointCalibration &cal = joint.calibration;
+        if (key == "bus" && !value.empty())
+            joint_buses.back() = value;
+        else if (key == "id" && isInt && number >= 0 && number <= 31)
+            joint.id = number;
+        else if (key == "model" && !value.empty())
+            joint_models.back() = value;
+        else if (key == "offset" && isFloat)
+            cal.offset = real * DEG_TO_RAD;
+        else if (key == "sign" && isInt && (number == 1 || number == -1))
+            cal.sign = number;
+        else if (key == "gear" && isFloat && real != 0.0f)
+            cal.gear = real;
+        else if (key == "min" && isFloat)
+            cal.minRad = real * DEG_TO_RAD;
+        else if (key == "max" && isFloat)
+            cal.maxRad = real * DEG_TO_RAD;
+        else if (key == "mirror" && !value.empty())
+            joint_mirrors.back() = value;
+        else
+        {
+            if (key != "bus" && key != "id" && key != "model" && key != "offset" && key != "sign" && key != "gear" &&
+                key != "min" && key != "max" && key != "mirror")
+                error = "unknown key " + key + " in [" + section + "]";
+            return false;
+        }
+        joint.calibrated = joint.calibrated || (key != "bus" && key != "id" && key != "model");
+        if (key == "sign" || key == "gear" || key == "min" || key == "max")
+            joint_shapes.back() = true;
+    }
+    error.clear();
+    return true;
+}
+
+/**
+ *@brief Turn the bus, model and mirror names into indices and check the whole robot
+ *@param[out] &error Message of the first problem found
+ *@param[out] &line Line of the section (or ids key) declaring the bus or joint at fault
+ *@return false on error
+ **/
+bool IcsTopology::resolve(std::string &error, int &line)
+{
+    for (int b = 0; b < getBusCount(); b++)
+    {
+        if (buses[b].device.empty())
+        {
+            error = "bus " + buses[b].name + " has no device";
+            line = bus_lines[b];
+            return false;
+        }
+        if (!bus_models[b].empty() && findModel(bus_models[b]) < 0)
+        {
+            error = "bus " + buses[b].name + ": unknown model " + bus_models[b];
+            line = bus_lines[b];
+            return false;
+        }
+    }
+
+    for (int j = 0; j < getJointCount(); j++)
+    {
+        IcsTopologyJoint &joint = joints[j];
+        line = joint_lines[j];
+        joint.bus = findBus(joint_buses[j]);
+        if (joint.bus < 0)
+        {
+            error = "joint " + joint.name + (joint_buses[j].empty() ? " has no bus" : ": unknown bus " + joint_buses[j]);
+            return false;
+        }
+
+        // A joint section names its model, an ids joint takes the model of its bus
+        const std::string &model = joint_models[j].empty() ? bus_models[joint.bus] : joint_models[j];
+        joint.model = model.empty() ? -1 : findModel(model);
+        if (!model.empty() && joint.model < 0)
+        {
+            error = "joint " + joint.name + ": unknown model " + model;
+            return false;
+        }
+
+        for (int k = 0; k < j; k++)
+        {
+            if (joints[k].bus == joint.bus && joints[k].id == joint.id)
+            {
+                error = "joints " + joints[k].name + " and " + joint.name + " share ID " + std::to_string(joint.id) +
+                        " on bus " + buses[joint.bus].name;
+                return false;
+            }
+        }
+
+        // Applied by buildCalibration(), once the calibration of the mirrored joint is known
+        joint.mirror = -1;
+        if (!joint_mirrors[j].empty())
+        {
+            joint.mirror = findJoint(joint_mirrors[j]);
+            if (joint.mirror < 0 || joint.mirror >= j)
+            {
+                error = "joint " + joint.name + ": mirror " + joint_mirrors[j] + " is not a joint above it";
+                return false;
+            }
+            if (joint_shapes[j])
+            {
+                error = "joint " + joint.name + ": sign, gear, min and max come from mirror " + joint_mirrors[j] +
+                        ", only offset may be set";
+                return false;
+            }
+        }
+    }
+    return true;
+}
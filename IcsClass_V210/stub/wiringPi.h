@@ -0,0 +1,44 @@
+/**
+ *  @file wiringPi.h
+ * @brief Stand-in for the wiringPi GPIO library on machines without Raspberry Pi GPIO
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Gpio_Stub_h_
+#define _ics_Gpio_Stub_h_
+
+// Only the part of the wiringPi API used by this library and its programs.
+// Pin levels are remembered but drive nothing, delays and clocks are real.
+
+#define ICS_GPIO_STUB 1
+
+#define INPUT 0
+#define OUTPUT 1
+
+#define LOW 0
+#define HIGH 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  int wiringPiSetupGpio(void);
+  void pinMode(int pin, int mode);
+  void digitalWrite(int pin, int value);
+  int digitalRead(int pin);
+
+  void delay(unsigned int howLong);
+  void delayMicroseconds(unsigned int howLong);
+  unsigned int millis(void);
+  unsigned int micros(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ *  @file IcsTest.h
+ * @brief Minimal checks shared by the regression tests (no test framework needed)
+ * @author Vyankatesh Ashtekar
+ * @date 2024/12/20
+ * @version 2.0.0
+ * @copyright Vyankatesh Ashtekar 2024
+
+**/
+
+#ifndef _ics_Test_h_
+#define _ics_Test_h_
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+/// Failed checks of the running test, main() returns it
+static int ics_test_failures = 0;
+
+/**
+ * @brief Record a failed check with its location, the test carries on
+ **/
+#define ICS_CHECK(condition)                                                         \
+  do                                                                                 \
+  {                                                                                  \
+    if (!(condition))                                                                \
+    {                                                                                \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      ics_test_failures++;                                                           \
+    }                                                                                \
+  } while (0)
+
+/**
+ * @brief Write text to a fresh temporary file
+ * @param[in] &text File contents
+ * @return Path of the file, removed by the caller
+ **/
+static inline std::string icsTestFile(const std::string &text)
+{
+  char path[] = "/tmp/ics_test_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || write(fd, text.data(), text.size()) != (ssize_t)text.size())
+  {
+    perror("mkstemp");
+    exit(2);
+  }
+  close(fd);
+  return path;
+}
+
+/**
+ * @brief Test result for ctest
+ * @return 0 if every check passed
+ **/
+static inline int icsTestResult()
+{
+  if (ics_test_failures)
+    fprintf(stderr, "%d check(s) failed\n", ics_test_failures);
+  return ics_test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ *@file test_bus_scan.cpp
+ *@brief Servo discovery against IcsServoSim: present IDs, shared IDs, and noise that must not pass for a shared ID
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsBusScan.h"
+#include "IcsHardSerialClass.h"
+#include "IcsServoSim.h"
+#include "IcsTest.h"
+
+namespace
+{
+  const unsigned int BAUDRATE = 1250000;
+
+  // Scan IDs 0-7 of a chain of servos 0, 1, 2 (and a second servo 1 if shared)
+  IcsScanBus scanChain(bool shared, double bitFlip, unsigned int seed)
+  {
+    IcsServoSim sim(BAUDRATE);
+    sim.addServos(3);
+    if (shared)
+      sim.addServo(1);
+    IcsSimFaults faults;
+    faults.bitFlip = bitFlip;
+    faults.seed = seed;
+    sim.setFaults(faults);
+    if (!sim.open() || !sim.start())
+    {
+      fprintf(stderr, "unable to start the servo simulator\n");
+      exit(2);
+    }
+
+    IcsHardSerialClass krs(sim.getDevice(), 17, BAUDRATE, 10);
+    IcsBusScan scanner;
+    scanner.setIdMask(0xFF);
+    IcsScanBus result;
+    scanner.scanBus(krs, result);
+    return result;
+  }
+}
+
+int main()
+{
+  IcsScanBus clean = scanChain(false, 0.0, 1);
+  ICS_CHECK(clean.present == 0x7);
+  ICS_CHECK(clean.ids.size() == 3);
+  ICS_CHECK(clean.duplicates == 0 && clean.partial == 0);
+  ICS_CHECK(clean.temperature[0] != IcsBaseClass::ICS_FALSE && clean.temperature[3] == IcsBaseClass::ICS_FALSE);
+
+  IcsScanBus shared = scanChain(true, 0.0, 1);
+  ICS_CHECK(shared.present == 0x7);
+  ICS_CHECK(shared.duplicates == 0x2);
+
+  // Single bit errors hit a few replies: the re-probe keeps them from being reported as shared IDs
+  for (unsigned int seed = 1; seed <= 8; seed++)
+  {
+    IcsScanBus noisy = scanChain(false, 0.03, seed);
+    ICS_CHECK(noisy.duplicates == 0);
+    ICS_CHECK(noisy.present == 0x7);
+  }
+  return icsTestResult();
+}
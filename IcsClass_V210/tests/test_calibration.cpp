@@ -0,0 +1,89 @@
+/**
+ *@file test_calibration.cpp
+ *@brief Calibration round trip: file -> table -> positions -> joint angles, mirrors and soft limits
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cmath>
+#include "IcsCalibration.h"
+#include "IcsTest.h"
+
+namespace
+{
+  const float DEG = 3.14159265f / 180.0f;
+
+  // Joint 0 plain, joint 1 reversed and geared, joint 2 mirrors joint 0 with its own offset
+  const char *calibrationText = "# joint  offset  sign  gear  min   max\n"
+                                "0        10.0    1     1.0   -90   90\n"
+                                "1        -5.0    -1    2.0   -45   45    # geared\n"
+                                "\n"
+                                "2        mirror  0     3.0\n";
+
+  void testRoundTrip(const IcsCalibration &calibration)
+  {
+    const float rad[3] = {30 * DEG, -20 * DEG, 45 * DEG};
+    unsigned int pos[3];
+    ICS_CHECK(calibration.toPositions(rad, pos) == 0);
+
+    // Servo angle = sign * gear * joint angle + offset, 7500 at servo angle 0
+    ICS_CHECK(std::abs((int)pos[0] - (int)std::lround(7500 + IcsCalibration::POS_PER_RAD * 40 * DEG)) <= 1);
+    ICS_CHECK(std::abs((int)pos[1] - (int)std::lround(7500 + IcsCalibration::POS_PER_RAD * 35 * DEG)) <= 1);
+    ICS_CHECK(std::abs((int)pos[2] - (int)std::lround(7500 + IcsCalibration::POS_PER_RAD * -42 * DEG)) <= 1);
+
+    int readBack[3] = {(int)pos[0], (int)pos[1], (int)pos[2]};
+    float back[3];
+    ICS_CHECK(calibration.toRadians(readBack, back) == 0);
+    for (int j = 0; j < 3; j++)
+      ICS_CHECK(std::fabs(back[j] - rad[j]) < 0.1f * DEG);
+  }
+
+  void testLimits(const IcsCalibration &calibration)
+  {
+    // Joint 1 beyond its soft limit, joint 2 (mirror of joint 0) beyond the mirrored one
+    const float rad[3] = {0.0f, 60 * DEG, -100 * DEG};
+    unsigned int pos[3];
+    unsigned int mask = 0;
+    ICS_CHECK(calibration.toPositions(rad, pos, &mask) == 2);
+    ICS_CHECK(mask == 0x6);
+
+    float back[3];
+    int readBack[3] = {(int)pos[0], (int)pos[1], (int)pos[2]};
+    calibration.toRadians(readBack, back);
+    ICS_CHECK(std::fabs(back[1] - 45 * DEG) < 0.1f * DEG);
+    ICS_CHECK(std::fabs(back[2] + 90 * DEG) < 0.1f * DEG);
+  }
+
+  void testLoadErrors()
+  {
+    IcsCalibration calibration;
+    std::string path = icsTestFile("0  0.0  1  1.0  -90\n");
+    ICS_CHECK(!calibration.load(path.c_str()));
+    unlink(path.c_str());
+
+    path = icsTestFile("3  mirror  7\n");
+    ICS_CHECK(!calibration.load(path.c_str()));
+    unlink(path.c_str());
+
+    ICS_CHECK(!calibration.load("/nonexistent/calibration.txt"));
+  }
+}
+
+int main()
+{
+  std::string path = icsTestFile(calibrationText);
+  IcsCalibration calibration;
+  ICS_CHECK(calibration.load(path.c_str()));
+  unlink(path.c_str());
+
+  ICS_CHECK(calibration.getJointCount() == 3);
+  ICS_CHECK(calibration.getJoint(2).sign == -1);
+  ICS_CHECK(std::fabs(calibration.getJoint(2).offset - 3 * DEG) < 1e-6f);
+
+  testRoundTrip(calibration);
+  testLimits(calibration);
+  testLoadErrors();
+  return icsTestResult();
+}
@@ -0,0 +1,115 @@
+/**
+ *@file test_read_frame.cpp
+ *@brief Reply framing of IcsHardSerialClass: never more than the frame, inter-byte and whole-reply deadlines
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include "IcsHardSerialClass.h"
+#include "IcsTest.h"
+
+namespace
+{
+  const unsigned int BAUDRATE = 115200;
+
+  // Opens readFrame() to the test
+  class FrameReader : public IcsHardSerialClass
+  {
+  public:
+    FrameReader(const char *device) : IcsHardSerialClass(device, 17, BAUDRATE, 100) {}
+    using IcsHardSerialClass::readFrame;
+  };
+
+  // The test plays the servo on the master side of a pty
+  int openMaster()
+  {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+      perror("posix_openpt");
+      exit(2);
+    }
+    return master;
+  }
+
+  void send(int master, const unsigned char *bytes, size_t count)
+  {
+    if (write(master, bytes, count) != (ssize_t)count)
+      perror("write");
+  }
+
+  // Extra input stays in the driver: rxLen bytes are stored and the rest is the next frame
+  void testBounds(int master, FrameReader &krs)
+  {
+    const unsigned char reply[6] = {0x80, 0x3A, 0x4C, 0x81, 0x3B, 0x4D};
+    send(master, reply, sizeof reply);
+    usleep(2000);
+
+    unsigned char rx[8];
+    memset(rx, 0xEE, sizeof rx);
+    ICS_CHECK(krs.readFrame(rx, 3, IcsClock::deadlineNs(10 * IcsClock::NS_PER_MS)) == 3);
+    ICS_CHECK(memcmp(rx, reply, 3) == 0);
+    ICS_CHECK(rx[3] == 0xEE && rx[7] == 0xEE);
+
+    ICS_CHECK(krs.readFrame(rx, 3, IcsClock::deadlineNs(10 * IcsClock::NS_PER_MS)) == 3);
+    ICS_CHECK(memcmp(rx, reply + 3, 3) == 0);
+  }
+
+  // Nothing comes: 0 bytes, not before the deadline
+  void testDeadline(FrameReader &krs)
+  {
+    unsigned char rx[3];
+    long long start = IcsClock::nowNs();
+    ICS_CHECK(krs.readFrame(rx, 3, start + 5 * IcsClock::NS_PER_MS) == 0);
+    ICS_CHECK(IcsClock::nowNs() - start >= 5 * IcsClock::NS_PER_MS);
+  }
+
+  // The reply stops after one byte: readFrame gives up after the inter-byte timeout, well before the frame deadline
+  void testInterByteTimeout(int master, FrameReader &krs)
+  {
+    krs.setInterByteTimeout(2000);
+    const unsigned char reply[3] = {0x80, 0x3A, 0x4C};
+
+    std::thread servo([&]()
+                      {
+                        send(master, reply, 1);
+                        usleep(30000);
+                        send(master, reply + 1, 2); });
+
+    unsigned char rx[3];
+    long long start = IcsClock::nowNs();
+    ICS_CHECK(krs.readFrame(rx, 3, start + 100 * IcsClock::NS_PER_MS) == 1);
+    ICS_CHECK(IcsClock::nowNs() - start < 20 * IcsClock::NS_PER_MS);
+    servo.join();
+
+    // A gap shorter than the inter-byte timeout is part of the same reply
+    krs.resync();
+    krs.setInterByteTimeout(50000);
+    std::thread slowServo([&]()
+                          {
+                            send(master, reply, 1);
+                            usleep(10000);
+                            send(master, reply + 1, 2); });
+    ICS_CHECK(krs.readFrame(rx, 3, IcsClock::deadlineNs(100 * IcsClock::NS_PER_MS)) == 3);
+    ICS_CHECK(memcmp(rx, reply, 3) == 0);
+    slowServo.join();
+  }
+}
+
+int main()
+{
+  int master = openMaster();
+  FrameReader krs(ptsname(master));
+
+  testBounds(master, krs);
+  testDeadline(krs);
+  testInterByteTimeout(master, krs);
+
+  close(master);
+  return icsTestResult();
+}
@@ -0,0 +1,91 @@
+/**
+ *@file test_resync.cpp
+ *@brief Stale replies: duplicate and late answers from IcsServoSim must not be taken for the next reply
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include "IcsHardSerialClass.h"
+#include "IcsServoSim.h"
+#include "IcsTest.h"
+
+namespace
+{
+  const unsigned int BAUDRATE = 115200;
+  const int TIMEOUT_MS = 20;
+
+  // Two servos that jump straight to their command, so every reply is known in advance
+  void startSim(IcsServoSim &sim)
+  {
+    IcsServoModel model;
+    model.order = IcsServoModel::MODEL_NONE;
+    sim.setModel(model);
+    sim.addServos(2);
+    if (!sim.open() || !sim.start())
+    {
+      fprintf(stderr, "unable to start the servo simulator\n");
+      exit(2);
+    }
+  }
+
+  void setFaults(IcsServoSim &sim, double duplicate, double late, long long lateDelayNs)
+  {
+    IcsSimFaults faults;
+    faults.duplicateReply = duplicate;
+    faults.lateReply = late;
+    faults.lateDelayNs = lateDelayNs;
+    sim.setFaults(faults);
+  }
+
+  // A second servo with the same ID answers after a successful exchange. Its reply sits in the input buffer and
+  // must be dropped, not returned by the next command to the same servo.
+  void testDuplicateReply()
+  {
+    IcsServoSim sim(BAUDRATE);
+    startSim(sim);
+    IcsHardSerialClass krs(sim.getDevice(), 17, BAUDRATE, TIMEOUT_MS);
+
+    ICS_CHECK(krs.setPos(0, 8000) != IcsBaseClass::ICS_FALSE);
+    setFaults(sim, 1.0, 0.0, 0);
+    ICS_CHECK(krs.setPos(0, 8500) == 8000);
+    setFaults(sim, 0.0, 0.0, 0);
+    usleep(5000); // the duplicate is in by now
+
+    ICS_CHECK(krs.setPos(0, 9000) == 8500);
+    ICS_CHECK(krs.getStats().staleBytes == 3);
+    ICS_CHECK(krs.setPos(0, 9000) == 9000);
+  }
+
+  // A reply that misses the timeout, for different delays around it. Whatever part of it arrives later must be
+  // drained, so only the late command fails and the next ones get their own replies.
+  void testLateReply()
+  {
+    IcsServoSim sim(BAUDRATE);
+    startSim(sim);
+    IcsHardSerialClass krs(sim.getDevice(), 17, BAUDRATE, TIMEOUT_MS);
+    ICS_CHECK(krs.setPos(0, 7000) == 7500);
+    ICS_CHECK(krs.setPos(1, 8000) == 7500);
+
+    const long long timeoutNs = TIMEOUT_MS * IcsClock::NS_PER_MS;
+    for (long long delayNs = timeoutNs - 500000; delayNs <= timeoutNs + 2000000; delayNs += 250000)
+    {
+      setFaults(sim, 0.0, 1.0, delayNs);
+      krs.getPos(1);
+      setFaults(sim, 0.0, 0.0, 0);
+
+      ICS_CHECK(krs.getPos(1) == 8000);
+      ICS_CHECK(krs.getPos(0) == 7000);
+      ICS_CHECK(krs.getPos(1) == 8000);
+    }
+    ICS_CHECK(krs.getStats().lateReplies > 0);
+  }
+}
+
+int main()
+{
+  testDuplicateReply();
+  testLateReply();
+  return icsTestResult();
+}
@@ -0,0 +1,166 @@
+/**
+ *@file test_topology.cpp
+ *@brief Topology parser: a valid robot description, and the errors of broken ones with their line
+ *@author Vyankatesh Ashtekar
+ *@date 2024/12/20
+ *@version 2.0.0
+ *@copyright © Vyankatesh Ashtekar
+ **/
+
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include "IcsCalibration.h"
+#include "IcsTopology.h"
+#include "IcsTest.h"
+
+namespace
+{
+  const char *robotText = "[robot]\n"
+                          "baudrate = 1250000\n"
+                          "timeout = 10         ; ms\n"
+                          "\n"
+                          "[model.krs]\n"
+                          "speed = 100\n"
+                          "\n"
+                          "[bus.L]\n"
+                          "device = /dev/ttyAMA1\n"
+                          "ids = 1, 2\n"
+                          "model = krs\n"
+                          "\n"
+                          "[bus.R]\n"
+                          "device = /dev/ttyAMA2\n"
+                          "enpin = 17\n"
+                          "baudrate = 115200\n"
+                          "\n"
+                          "[joint.knee]\n"
+                          "bus = R\n"
+                          "id = 3\n"
+                          "sign = -1\n";
+
+  // Parse text, return what went to std::cerr ("" if it parsed)
+  std::string parseError(const std::string &text)
+  {
+    std::ostringstream captured;
+    std::streambuf *saved = std::cerr.rdbuf(captured.rdbuf());
+    IcsTopology topology;
+    bool ok = topology.parse(text, "robot.ini");
+    std::cerr.rdbuf(saved);
+
+    ICS_CHECK(ok == captured.str().empty());
+    return captured.str();
+  }
+
+  // The error names the file, the line and the reason
+  bool reports(const std::string &text, const std::string &where, const std::string &what)
+  {
+    std::string error = parseError(text);
+    bool ok = error.find("robot.ini:" + where + ":") != std::string::npos && error.find(what) != std::string::npos;
+    if (!ok)
+      fprintf(stderr, "expected robot.ini:%s: ... %s, got: %s", where.c_str(), what.c_str(), error.c_str());
+    return ok;
+  }
+
+  void testValid()
+  {
+    IcsTopology topology;
+    ICS_CHECK(topology.parse(robotText, "robot.ini"));
+    ICS_CHECK(topology.getBusCount() == 2);
+    ICS_CHECK(topology.getJointCount() == 3);
+    ICS_CHECK(topology.getModelCount() == 1);
+
+    int left = topology.findBus("L");
+    int right = topology.findBus("R");
+    ICS_CHECK(left == 0 && right == 1);
+    ICS_CHECK(topology.getBaudrate(left) == 1250000);
+    ICS_CHECK(topology.getBaudrate(right) == 115200);
+    ICS_CHECK(topology.getTimeout(right) == 10);
+    ICS_CHECK(topology.getEnablePin(right) == 17);
+
+    // ids entries first, joint sections after, in file order
+    ICS_CHECK(topology.getJoint(1).id == 2 && topology.getJoint(1).bus == left);
+    int knee = topology.findJoint("knee");
+    ICS_CHECK(knee == 2);
+    ICS_CHECK(topology.getJoint(knee).bus == right && topology.getJoint(knee).id == 3);
+    ICS_CHECK(topology.getJoint(knee).calibrated && topology.getJoint(knee).calibration.sign == -1);
+    ICS_CHECK(topology.getModel(topology.findModel("krs")).speed == 100);
+  }
+
+  // Numbers are decimal, zero padded ones included (no octal)
+  void testDecimal()
+  {
+    IcsTopology topology;
+    ICS_CHECK(topology.parse("[bus.L]\ndevice = /dev/ttyAMA1\nenpin = 010\nids = 08, 09\n", "robot.ini"));
+    ICS_CHECK(topology.getEnablePin(0) == 10);
+    ICS_CHECK(topology.getJointCount() == 2 && topology.getJoint(0).id == 8 && topology.getJoint(1).id == 9);
+    ICS_CHECK(reports("[robot]\ntimeout = 0x10\n", "2", "invalid value for timeout"));
+  }
+
+  void testParseErrors()
+  {
+    ICS_CHECK(reports("[robot\n", "1", "']' expected"));
+    ICS_CHECK(reports("baudrate = 115200\n", "1", "key outside a section"));
+    ICS_CHECK(reports("[robot]\nbaudrate\n", "2", "'=' expected"));
+    ICS_CHECK(reports("[robot]\n\n[servo.x]\n", "3", "unknown section"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\n[bus.L]\n", "3", "duplicate section"));
+    ICS_CHECK(reports("[robot]\nbaud = 115200\n", "2", "unknown key baud"));
+    ICS_CHECK(reports("[robot]\ntimeout = ten\n", "2", "invalid value for timeout"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\nids = 1, 40\n", "3", "invalid value for ids"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\nids = 1, 2, 1\n", "3", "ID 1 listed twice"));
+    ICS_CHECK(reports("[model.krs]\nspeed = 200\n", "2", "invalid value for speed"));
+  }
+
+  // Names are resolved after the whole file is read, the error points at the section (or ids key) at fault
+  void testResolveErrors()
+  {
+    ICS_CHECK(reports("[bus.L]\nids = 1\n", "1", "bus L has no device"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\nmodel = none\n", "1", "unknown model none"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\n\n[joint.a]\nbus = X\nid = 1\n", "4", "unknown bus X"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\n[joint.a]\nid = 1\n", "3", "joint a has no bus"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\n[joint.a]\nbus = L\nmodel = m\n", "3", "unknown model m"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\nids = 4\n[joint.a]\nbus = L\nid = 4\n", "4", "share ID 4"));
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\n[joint.a]\nbus = L\nid = 1\nmirror = b\n", "3",
+                      "mirror b is not a joint above it"));
+  }
+
+  // A mirror follows its joint as calibrated by the calibration file, with its own offset
+  void testMirror()
+  {
+    const float DEG = 3.14159265f / 180.0f;
+    std::string file = icsTestFile("0  5.0  -1  2.0  -30  60\n"
+                                   "1  0.0   1  1.0  -90  90\n"
+                                   "2  0.0   1  1.0  -90  90\n");
+    IcsTopology topology;
+    ICS_CHECK(topology.parse("[robot]\ncalibration = " + file +
+                                 "\n[bus.L]\ndevice = /dev/ttyAMA1\nids = 1\n"
+                                 "[joint.r]\nbus = L\nid = 2\nmirror = L.1\noffset = -4\n"
+                                 "[joint.rr]\nbus = L\nid = 3\nmirror = r\n",
+                             "robot.ini"));
+    ICS_CHECK(topology.getJoint(1).mirror == 0 && topology.getJoint(2).mirror == 1);
+
+    IcsCalibration calibration;
+    ICS_CHECK(topology.buildCalibration(calibration));
+    unlink(file.c_str());
+    const IcsJointCalibration &r = calibration.getJoint(1);
+    ICS_CHECK(r.sign == 1 && r.gear == 2.0f);
+    ICS_CHECK(std::fabs(r.offset + 4 * DEG) < 1e-5f);
+    ICS_CHECK(std::fabs(r.minRad + 30 * DEG) < 1e-5f && std::fabs(r.maxRad - 60 * DEG) < 1e-5f);
+    const IcsJointCalibration &rr = calibration.getJoint(2);
+    ICS_CHECK(rr.sign == -1 && rr.gear == 2.0f && rr.offset == 0.0f);
+
+    // The mirrored joint decides sign, gear and limits
+    ICS_CHECK(reports("[bus.L]\ndevice = /dev/ttyAMA1\nids = 1\n[joint.r]\nbus = L\nid = 2\nmirror = L.1\n"
+                      "gear = 2\n",
+                      "4", "only offset may be set"));
+  }
+}
+
+int main()
+{
+  testValid();
+  testDecimal();
+  testParseErrors();
+  testResolveErrors();
+  testMirror();
+  return icsTestResult();
+}
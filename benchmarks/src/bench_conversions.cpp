@@ -0,0 +1,432 @@
+// Cost of the per-joint hot-path math: angle conversions and the position frame encode/decode
+// Usage: ./bench_conversions [operations]
+// e.g.   ./bench_conversions 20000000
+// Every function is timed for one joint and for arrays of 20-160 joints, next to float, fixed-point,
+// table-driven and batch (SIMD) alternatives. IcsAngleFixed uses its own exact ratio, so its mismatch count shows
+// how far the library's x100 functions are from it. Each alternative is checked against the library over its whole input range first,
+// so a faster row that prints a mismatch count is not a drop-in replacement.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <IcsClock.h>
+#include <IcsBaseClass.h>
+#include <IcsAngleFixed.h>
+#include <IcsCommand.h>
+
+// Operations per measurement (spread over the repetitions of one array)
+long long operations = 10000000;
+
+// Joint counts to measure (1 = scalar)
+const int jointCounts[] = {1, 20, 40, 80, 160};
+
+// Position range of the servo (3500-11500)
+const int POS_LOW = IcsBaseClass::MIN_POS;
+const int POS_HIGH = IcsBaseClass::MAX_POS;
+const int POS_SPAN = POS_HIGH - POS_LOW + 1;
+
+// Limits and error values of the library conversions (protected in IcsBaseClass)
+const float MAX_DEG = 180.0f;
+const float MIN_DEG = -180.0f;
+const int MAX_100DEG = 18000;
+const int MIN_100DEG = -18000;
+const float ANGLE_F_FALSE = 9999.9f;
+const int ANGLE_I_FALSE = 0x7FFF;
+
+// Keep the compiler from dropping or hoisting the work on a buffer
+static inline void clobber(const void *p)
+{
+  asm volatile("" : : "r"(p) : "memory");
+}
+
+// Alternatives ////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Same code as the library, but visible to the compiler so it can be inlined
+static inline int degPosInline(float deg)
+{
+  if (deg > MAX_DEG || deg < MIN_DEG)
+    return -1;
+  int pos = deg * 29.633;
+  return pos + 7500;
+}
+
+// Single precision only (the library multiplies in double)
+static inline int degPosFloat(float deg)
+{
+  if (deg > MAX_DEG || deg < MIN_DEG)
+    return -1;
+  return (int)(deg * 29.633f) + 7500;
+}
+
+static inline float posDegInline(int pos)
+{
+  float deg = (pos - 7500) / 29.633;
+  if (deg > MAX_DEG)
+    return ANGLE_F_FALSE;
+  if (deg < MIN_DEG)
+    return -ANGLE_F_FALSE;
+  return deg;
+}
+
+// Single precision reciprocal instead of a double division
+static inline float posDegFloat(int pos)
+{
+  float deg = (pos - 7500) * (1.0f / 29.633f);
+  if (deg > MAX_DEG)
+    return ANGLE_F_FALSE;
+  if (deg < MIN_DEG)
+    return -ANGLE_F_FALSE;
+  return deg;
+}
+
+static inline int degPos100Inline(int deg)
+{
+  if (deg > MAX_100DEG || deg < MIN_100DEG)
+    return -1;
+  return (int)(((long)deg * 2963) / 10000) + 7500;
+}
+
+static inline int posDeg100Inline(int pos)
+{
+  long a = pos - 7500;
+  int deg = (a * 1000) / 296;
+  if (deg > MAX_100DEG)
+    return ANGLE_I_FALSE;
+  if (deg < MIN_100DEG)
+    return -ANGLE_I_FALSE;
+  return deg;
+}
+
+// Tables over the servo position range, filled from the library functions
+float posDegTable[POS_SPAN];
+int posDeg100Table[POS_SPAN];
+
+static inline float posDegLookup(int pos)
+{
+  unsigned int i = (unsigned int)(pos - POS_LOW);
+  return (i < (unsigned int)POS_SPAN) ? posDegTable[i] : IcsBaseClass::posDeg(pos);
+}
+
+static inline int posDeg100Lookup(int pos)
+{
+  unsigned int i = (unsigned int)(pos - POS_LOW);
+  return (i < (unsigned int)POS_SPAN) ? posDeg100Table[i] : IcsBaseClass::posDeg100(pos);
+}
+
+// Position frame as built inline by setPos()/getPos()
+static inline void encodePosInline(unsigned char id, unsigned int pos, unsigned char *tx)
+{
+  tx[0] = 0x80 + id;
+  tx[1] = (pos >> 7) & 0x007F;
+  tx[2] = pos & 0x007F;
+}
+
+static inline int decodePosInline(const unsigned char *rx)
+{
+  return ((rx[1] << 7) & 0x3F80) + (rx[2] & 0x007F);
+}
+
+// Measurement //////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Time kernel(n) repeatedly and return ns per converted joint
+template <typename Kernel>
+static double nsPerOp(int n, Kernel kernel)
+{
+  long long reps = operations / n;
+  if (reps < 1)
+    reps = 1;
+  for (long long r = 0; r < reps / 10 + 1; r++) // warm up caches and the branch predictor
+    kernel(n);
+
+  long long t0 = IcsClock::nowNs();
+  for (long long r = 0; r < reps; r++)
+    kernel(n);
+  return (double)(IcsClock::nowNs() - t0) / (reps * n);
+}
+
+// Count inputs where an alternative differs from the library
+template <typename In, typename Ref, typename Alt>
+static long checkRange(In low, In high, Ref ref, Alt alt)
+{
+  long mismatches = 0;
+  for (In x = low; x <= high; x++)
+    if (ref(x) != alt(x))
+      mismatches++;
+  return mismatches;
+}
+
+// Float inputs are checked on a 0.001 deg grid, which covers every position step several times
+template <typename Ref, typename Alt>
+static long checkDegrees(Ref ref, Alt alt)
+{
+  long mismatches = 0;
+  for (int m = -185000; m <= 185000; m++)
+  {
+    float deg = m / 1000.0f;
+    if (ref(deg) != alt(deg))
+      mismatches++;
+  }
+  return mismatches;
+}
+
+// Batch conversions checked the same way, in one call over the whole grid
+static long checkDegPosBatch()
+{
+  std::vector<float> deg;
+  for (int m = -185000; m <= 185000; m++)
+    deg.push_back(m / 1000.0f);
+  std::vector<int> pos(deg.size());
+  std::vector<unsigned int> mask((deg.size() + 31) / 32);
+  IcsBaseClass::degPosBatch(deg.data(), pos.data(), deg.size(), mask.data());
+
+  long mismatches = 0;
+  for (size_t i = 0; i < deg.size(); i++)
+  {
+    int ref = IcsBaseClass::degPos(deg[i]);
+    bool masked = (mask[i / 32] >> (i % 32)) & 1;
+    if (pos[i] != ref || masked != (ref == -1))
+      mismatches++;
+  }
+  return mismatches;
+}
+
+static long checkPosDegBatch()
+{
+  std::vector<int> pos;
+  for (int p = 0; p <= 16383; p++)
+    pos.push_back(p);
+  std::vector<float> deg(pos.size());
+  IcsBaseClass::posDegBatch(pos.data(), deg.data(), pos.size());
+
+  long mismatches = 0;
+  for (size_t i = 0; i < pos.size(); i++)
+  {
+    float ref = IcsBaseClass::posDeg(pos[i]);
+    if (memcmp(&deg[i], &ref, sizeof ref) != 0) // bit for bit
+      mismatches++;
+  }
+  return mismatches;
+}
+
+static void printRow(const char *name, const double *ns, long mismatches)
+{
+  printf("  %-22s", name);
+  for (size_t i = 0; i < sizeof jointCounts / sizeof jointCounts[0]; i++)
+    printf(" %8.2f", ns[i]);
+  if (mismatches < 0)
+    printf("   reference\n");
+  else
+    printf("   %ld mismatches\n", mismatches);
+}
+
+static void printHeader(const char *title)
+{
+  printf("\n%s (ns/joint)\n  %-22s", title, "");
+  for (size_t i = 0; i < sizeof jointCounts / sizeof jointCounts[0]; i++)
+    printf(" %8d", jointCounts[i]);
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    operations = atoll(argv[1]);
+  if (operations < 1000)
+    operations = 1000;
+
+  const int rows = sizeof jointCounts / sizeof jointCounts[0];
+  const int maxJoints = 160;
+
+  for (int i = 0; i < POS_SPAN; i++)
+  {
+    posDegTable[i] = IcsBaseClass::posDeg(POS_LOW + i);
+    posDeg100Table[i] = IcsBaseClass::posDeg100(POS_LOW + i);
+  }
+
+  // Inputs spread over a typical joint range (+-135 deg), outputs written back to arrays
+  std::vector<float> degIn(maxJoints), degOut(maxJoints);
+  std::vector<int> deg100In(maxJoints), posIn(maxJoints), intOut(maxJoints);
+  std::vector<unsigned int> mask((maxJoints + 31) / 32);
+  std::vector<unsigned char> frames(maxJoints * 3);
+  std::vector<IcsCommand> commands(maxJoints);
+  for (int j = 0; j < maxJoints; j++)
+  {
+    degIn[j] = -135.0f + 270.0f * ((j * 37) % maxJoints) / maxJoints;
+    deg100In[j] = (int)(degIn[j] * 100.0f);
+    posIn[j] = IcsBaseClass::degPos(degIn[j]);
+    commands[j] = IcsCommand(IcsCommand::SET_POS, j % 32, posIn[j]);
+    encodePosInline(j % 32, posIn[j], &frames[j * 3]);
+  }
+
+  printf("%lld operations per measurement\n", operations);
+  double ns[rows];
+  char batchName[32];
+  snprintf(batchName, sizeof batchName, "batch (%s)", IcsBaseClass::batchKernel());
+
+  // degPos //////////////////////////////////////////////////////////////////
+  printHeader("degPos (float deg -> pos)");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = IcsBaseClass::degPos(degIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("library (double)", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = degPosInline(degIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("inlined (double)", ns, checkDegrees(IcsBaseClass::degPos, degPosInline));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = degPosFloat(degIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("inlined (float)", ns, checkDegrees(IcsBaseClass::degPos, degPosFloat));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      IcsBaseClass::degPosBatch(degIn.data(), intOut.data(), n, mask.data());
+      clobber(intOut.data());
+    });
+  printRow(batchName, ns, checkDegPosBatch());
+
+  // posDeg //////////////////////////////////////////////////////////////////
+  printHeader("posDeg (pos -> float deg)");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        degOut[j] = IcsBaseClass::posDeg(posIn[j]);
+      clobber(degOut.data());
+    });
+  printRow("library (double div)", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        degOut[j] = posDegInline(posIn[j]);
+      clobber(degOut.data());
+    });
+  printRow("inlined (double div)", ns, checkRange(0, 16383, IcsBaseClass::posDeg, posDegInline));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        degOut[j] = posDegFloat(posIn[j]);
+      clobber(degOut.data());
+    });
+  printRow("inlined (float mul)", ns, checkRange(0, 16383, IcsBaseClass::posDeg, posDegFloat));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        degOut[j] = posDegLookup(posIn[j]);
+      clobber(degOut.data());
+    });
+  printRow("table", ns, checkRange(0, 16383, IcsBaseClass::posDeg, posDegLookup));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      IcsBaseClass::posDegBatch(posIn.data(), degOut.data(), n, mask.data());
+      clobber(degOut.data());
+    });
+  printRow(batchName, ns, checkPosDegBatch());
+
+  // degPos100 ///////////////////////////////////////////////////////////////
+  printHeader("degPos100 (deg x100 -> pos)");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = IcsBaseClass::degPos100(deg100In[j]);
+      clobber(intOut.data());
+    });
+  printRow("library (fixed)", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = degPos100Inline(deg100In[j]);
+      clobber(intOut.data());
+    });
+  printRow("inlined (fixed)", ns, checkRange(-20000, 20000, IcsBaseClass::degPos100, degPos100Inline));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = degPosInline(deg100In[j] * 0.01f);
+      clobber(intOut.data());
+    });
+  printRow("via float degPos", ns, checkRange(-20000, 20000, IcsBaseClass::degPos100, [](int d) { return degPosInline(d * 0.01f); }));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = IcsAngleFixed::toPos(deg100In[j]);
+      clobber(intOut.data());
+    });
+  printRow("IcsAngleFixed (27/8)", ns, checkRange(-13500, 13500, IcsBaseClass::degPos100, IcsAngleFixed::toPos));
+
+  // posDeg100 ///////////////////////////////////////////////////////////////
+  printHeader("posDeg100 (pos -> deg x100)");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = IcsBaseClass::posDeg100(posIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("library (fixed)", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = posDeg100Inline(posIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("inlined (fixed)", ns, checkRange(0, 16383, IcsBaseClass::posDeg100, posDeg100Inline));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = posDeg100Lookup(posIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("table", ns, checkRange(0, 16383, IcsBaseClass::posDeg100, posDeg100Lookup));
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = IcsAngleFixed::toDeg100(posIn[j]);
+      clobber(intOut.data());
+    });
+  printRow("IcsAngleFixed (27/8)", ns, checkRange(POS_LOW, POS_HIGH, IcsBaseClass::posDeg100, IcsAngleFixed::toDeg100));
+
+  // Position frames /////////////////////////////////////////////////////////
+  printHeader("Position frame encode");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        encodePosInline(j & 0x1F, posIn[j], &frames[j * 3]);
+      clobber(frames.data());
+    });
+  printRow("setPos() inline", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      unsigned char txLen, rxLen;
+      for (int j = 0; j < n; j++)
+        commands[j].encode(&frames[j * 3], txLen, rxLen);
+      clobber(frames.data());
+    });
+  printRow("IcsCommand::encode", ns, -1);
+
+  printHeader("Position frame decode");
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = decodePosInline(&frames[j * 3]);
+      clobber(intOut.data());
+    });
+  printRow("setPos() inline", ns, -1);
+  for (int i = 0; i < rows; i++)
+    ns[i] = nsPerOp(jointCounts[i], [&](int n) {
+      for (int j = 0; j < n; j++)
+        intOut[j] = commands[j].decode(&frames[j * 3]);
+      clobber(intOut.data());
+    });
+  printRow("IcsCommand::decode", ns, -1);
+
+  printf("\nlibrary rows call into libkondoKrsRpi.so (no inlining), inlined rows are the same code compiled here\n");
+  return 0;
+}
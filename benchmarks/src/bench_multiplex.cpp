@@ -0,0 +1,112 @@
+// Compare thread-per-bus (IcsBusHub) with the single-thread epoll engine (IcsEpollEngine)
+// Usage: ./bench_multiplex [cycles] [baudrate] [oepin]
+// Uses the four ports of the HDS PCB with the joint layout of all_motors.cpp (oepin -1: no level shifter to enable)
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <sys/resource.h>
+#include <wiringPi.h>
+#include <IcsClock.h>
+#include <IcsBusHub.h>
+#include <IcsEpollEngine.h>
+
+// Number of motors on each port
+int nm[4] = {6, 6, 4, 4};
+
+// Motor IDs
+int ID0[6] = {1, 2, 3, 4, 5, 6};    // LL
+int ID1[6] = {7, 8, 9, 10, 11, 12}; // RL
+int ID2[4] = {14, 15, 16, 17};      // LH
+int ID3[4] = {13, 18, 19, 20};      // RH
+int *IDs[4] = {ID0, ID1, ID2, ID3};
+
+// Enable pins BCM numbering
+int En[4] = {07, 06, 25, 19};
+// Serial ports
+const char *devices[4] = {"/dev/ttyAMA1", "/dev/ttyAMA2", "/dev/ttyAMA3", "/dev/ttyAMA4"};
+// Bidirectional voltage shifter OE (BCM numbering), as in all_motors.cpp
+int oePin = 26;
+
+unsigned int baudRate = 1250000;
+int timeout = 10;
+int cycles = 1000;
+
+// CPU time (user + system) consumed by the whole process in nanoseconds
+static long long cpuNs()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ((long long)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+         ((long long)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+// Run readPositions() on an engine for the configured number of cycles and print the results
+template <class Engine>
+static void runEngine(Engine &engine, const char *name)
+{
+  std::vector<int> pos(engine.getJointCount());
+  int failedCycles = 0;
+
+  long long wallStart = IcsClock::nowNs();
+  long long cpuStart = cpuNs();
+  for (int c = 0; c < cycles; c++)
+  {
+    if (!engine.readPositions(pos.data()))
+      failedCycles++;
+  }
+  long long wall = IcsClock::nowNs() - wallStart;
+  long long cpu = cpuNs() - cpuStart;
+
+  double seconds = wall / 1e9;
+  printf("%-6s  cycle %8.1f us  %8.1f Hz  %9.0f trans/s  cpu %5.1f %% of one core  failed cycles %d/%d\n",
+         name, wall / 1000.0 / cycles, cycles / seconds, (double)cycles * engine.getJointCount() / seconds,
+         100.0 * cpu / wall, failedCycles, cycles);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    cycles = atoi(argv[1]);
+  if (argc > 2)
+    baudRate = atoi(argv[2]);
+  if (argc > 3)
+    oePin = atoi(argv[3]);
+
+  if (wiringPiSetupGpio() == -1)
+  {
+    printf("Error initialising wiringPi GPIO\n");
+    return 1;
+  }
+  if (oePin >= 0)
+  {
+    // Bidirectional voltage shifter OE to HIGH, otherwise no reply reaches the UARTs
+    pinMode(oePin, OUTPUT);
+    digitalWrite(oePin, HIGH);
+    delay(100);
+  }
+
+  // The same bus objects are used by both engines, one after the other
+  std::vector<std::unique_ptr<IcsHardSerialClass>> ports;
+  IcsBusHub hub;
+  IcsEpollEngine epoll;
+  for (int b = 0; b < 4; b++)
+  {
+    ports.emplace_back(new IcsHardSerialClass(devices[b], En[b], baudRate, timeout));
+    ports[b]->setRxMode(IcsHardSerialClass::RX_MODE_POLL);
+    int hb = hub.addBus(*ports[b]);
+    int eb = epoll.addBus(*ports[b]);
+    for (int i = 0; i < nm[b]; i++)
+    {
+      hub.addJoint(hb, IDs[b][i]);
+      epoll.addJoint(eb, IDs[b][i]);
+    }
+  }
+
+  printf("readPositions x %d, %d joints on 4 buses at %u baud\n", cycles, hub.getJointCount(), baudRate);
+  runEngine(hub, "thread");
+  runEngine(epoll, "epoll");
+
+  return 0;
+}
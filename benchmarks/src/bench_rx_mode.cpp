@@ -0,0 +1,97 @@
+// Compare the reply wait strategies of IcsHardSerialClass (FIONREAD spin vs ppoll)
+// Usage: ./bench_rx_mode [device] [enpin] [baudrate] [id] [iterations] [oepin]
+// e.g.   ./bench_rx_mode /dev/ttyAMA1 7 1250000 1 5000 26   (oepin -1: no level shifter to enable)
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <wiringPi.h>
+#include <IcsClock.h>
+#include <IcsHardSerialClass.h>
+
+// Default test setup (port 0 of the HDS PCB)
+const char *device = "/dev/ttyAMA1";
+int enpin = 7;
+unsigned int baudRate = 1250000;
+int timeout = 10;
+int servoId = 1;
+int iterations = 2000;
+int oePin = 26; // Bidirectional voltage shifter OE, BCM numbering
+
+// CPU time (user + system) consumed by this thread in nanoseconds
+static long long cpuNs()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_THREAD, &ru);
+  return ((long long)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+         ((long long)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+// Run getPos repeatedly in the given mode and print latency and CPU usage
+static void runMode(IcsHardSerialClass &krs, IcsHardSerialClass::RxMode mode, const char *name)
+{
+  krs.setRxMode(mode);
+
+  long long minNs = -1, maxNs = 0, sumNs = 0;
+  int failures = 0;
+
+  long long wallStart = IcsClock::nowNs();
+  long long cpuStart = cpuNs();
+  for (int i = 0; i < iterations; i++)
+  {
+    long long t0 = IcsClock::nowNs();
+    int reply = krs.getPos(servoId);
+    long long dt = IcsClock::nowNs() - t0;
+
+    if (reply == IcsBaseClass::ICS_FALSE)
+      failures++;
+    sumNs += dt;
+    if (minNs < 0 || dt < minNs)
+      minNs = dt;
+    if (dt > maxNs)
+      maxNs = dt;
+  }
+  long long wall = IcsClock::nowNs() - wallStart;
+  long long cpu = cpuNs() - cpuStart;
+
+  printf("%-5s  mean %8.1f us  min %8.1f us  max %8.1f us  cpu %5.1f %%  failures %d/%d\n",
+         name, sumNs / 1000.0 / iterations, minNs / 1000.0, maxNs / 1000.0,
+         100.0 * cpu / wall, failures, iterations);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    device = argv[1];
+  if (argc > 2)
+    enpin = atoi(argv[2]);
+  if (argc > 3)
+    baudRate = atoi(argv[3]);
+  if (argc > 4)
+    servoId = atoi(argv[4]);
+  if (argc > 5)
+    iterations = atoi(argv[5]);
+  if (argc > 6)
+    oePin = atoi(argv[6]);
+
+  if (wiringPiSetupGpio() == -1)
+  {
+    printf("Error initialising wiringPi GPIO\n");
+    return 1;
+  }
+  if (oePin >= 0)
+  {
+    // Bidirectional voltage shifter OE to HIGH, otherwise only timeouts are measured
+    pinMode(oePin, OUTPUT);
+    digitalWrite(oePin, HIGH);
+    delay(100);
+  }
+
+  IcsHardSerialClass krs(device, enpin, baudRate, timeout);
+
+  printf("getPos(%d) x %d on %s at %u baud\n", servoId, iterations, device, baudRate);
+  runMode(krs, IcsHardSerialClass::RX_MODE_SPIN, "spin");
+  runMode(krs, IcsHardSerialClass::RX_MODE_POLL, "poll");
+
+  return 0;
+}
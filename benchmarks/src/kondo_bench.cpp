@@ -0,0 +1,427 @@
+// Sweep transaction throughput and full-robot cycle rate over baud rates, bus counts, servo counts and command types
+// Usage: ./kondo_bench [--baud list] [--buses list] [--servos list] [--cmds list] [--cycles n]
+//                      [--turnaround us] [--json file] [--hw device:enpin:id,id,...]... [--oe pin]
+// e.g.   ./kondo_bench --baud 115200,1250000 --buses 1,4 --servos 1,8 --cmds pos,read --json bench.json
+//        ./kondo_bench --baud 1250000 --hw /dev/ttyAMA1:7:1,2,3,4,5,6 --hw /dev/ttyAMA2:6:7,8,9,10,11,12
+// Without --hw every bus is an IcsServoSim chain running in a child process, so the CPU figures are the library's
+// own. With --hw the listed ports are used as they are (first n of them for --buses n), --servos is ignored, and the
+// level shifter OE pin (--oe, default BCM 26 of the HDS PCB, -1 for none) is driven high before the sweep.
+// The id command is left out of the default sweep: it needs a single servo per bus and getID() waits 520 ms after every
+// call, so 200 cycles take minutes per configuration. Ask for it with --cmds id --cycles 5.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wiringPi.h>
+#include <IcsClock.h>
+#include <IcsBusHub.h>
+#include <IcsHardSerialClass.h>
+#include <IcsLatency.h>
+#include <IcsServoSim.h>
+
+// Sweep defaults
+std::vector<int> bauds = {115200, 625000, 1250000};
+std::vector<int> busCounts = {1, 2, 3, 4, 5};
+std::vector<int> servoCounts = {1, 2, 4, 8, 16, 32};
+std::vector<std::string> cmds = {"pos", "read", "write"};
+int cycles = 200;
+int warmup = 10;
+int turnaroundUs = 100;
+int timeout = 10;
+const char *jsonPath = "kondo_bench.json";
+
+// Real hardware ports given with --hw
+struct HwBus
+{
+  std::string device;
+  int enpin;
+  std::vector<int> ids;
+};
+std::vector<HwBus> hwBuses;
+// Bidirectional voltage shifter OE (BCM numbering), only driven with --hw
+int oePin = 26;
+
+// Result of one configuration
+struct Result
+{
+  double transactionsPerS;
+  double cycleHz;
+  double cpuPercent;
+  unsigned long failed;
+  IcsLatencySnapshot cycle;
+  IcsLatencySnapshot transaction;
+};
+
+// CPU time (user + system) consumed by this process in nanoseconds
+static long long cpuNs()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ((long long)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000LL +
+         ((long long)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000LL;
+}
+
+// "1,2,3" -> {1, 2, 3}
+static std::vector<int> parseInts(const char *list)
+{
+  std::vector<int> values;
+  for (const char *p = list; *p;)
+  {
+    values.push_back(atoi(p));
+    p = strchr(p, ',');
+    if (!p)
+      break;
+    p++;
+  }
+  return values;
+}
+
+// "a,b" -> {"a", "b"}
+static std::vector<std::string> parseWords(const char *list)
+{
+  std::vector<std::string> words;
+  std::string item;
+  for (const char *p = list;; p++)
+  {
+    if (*p == ',' || *p == 0)
+    {
+      if (!item.empty())
+        words.push_back(item);
+      item.clear();
+      if (*p == 0)
+        break;
+    }
+    else
+    {
+      item += *p;
+    }
+  }
+  return words;
+}
+
+// "device:enpin:id,id" -> HwBus
+static bool parseHw(const char *spec, HwBus &bus)
+{
+  const char *a = strchr(spec, ':');
+  const char *b = a ? strchr(a + 1, ':') : NULL;
+  if (!b)
+    return false;
+  bus.device.assign(spec, a - spec);
+  bus.enpin = atoi(a + 1);
+  bus.ids = parseInts(b + 1);
+  return !bus.ids.empty();
+}
+
+// Command name -> hub command and the value it sends
+static bool commandType(const std::string &name, IcsCommand::Type &type, unsigned int &value)
+{
+  if (name == "pos")
+    type = IcsCommand::SET_POS, value = 7500;
+  else if (name == "read")
+    type = IcsCommand::GET_POS, value = 0;
+  else if (name == "write")
+    type = IcsCommand::SET_SPD, value = 127;
+  else if (name == "id")
+    type = IcsCommand::GET_ID, value = 0;
+  else
+    return false;
+  return true;
+}
+
+// Start one simulated chain per bus in a child process. Returns its pid, fills the device paths.
+// The child lives until *control is closed.
+static pid_t startSimulators(int buses, int servos, unsigned int baud, std::vector<std::string> &devices, int *control)
+{
+  int paths[2], ctl[2];
+  if (pipe(paths) != 0 || pipe(ctl) != 0)
+    return -1;
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(paths[0]);
+    close(ctl[1]);
+
+    std::vector<std::unique_ptr<IcsServoSim>> sims;
+    std::string list;
+    for (int b = 0; b < buses; b++)
+    {
+      IcsServoSim *sim = new IcsServoSim(baud);
+      IcsServoModel model;
+      model.order = IcsServoModel::MODEL_NONE; // Only the protocol timing matters here
+      sim->setModel(model);
+      sim->setTurnaround(turnaroundUs * 1000LL);
+      sim->addServos(servos);
+      sim->start();
+      sims.emplace_back(sim);
+      list += sim->getDevice();
+      list += '\n';
+    }
+    if (write(paths[1], list.c_str(), list.size()) < 0)
+      _exit(1);
+    close(paths[1]);
+
+    // Serve until the parent closes the control pipe
+    char c;
+    while (read(ctl[0], &c, 1) > 0)
+      ;
+    for (size_t i = 0; i < sims.size(); i++)
+      sims[i]->stop();
+    _exit(0);
+  }
+
+  close(paths[1]);
+  close(ctl[0]);
+  *control = ctl[1];
+
+  std::string list;
+  char buf[256];
+  ssize_t n;
+  while ((n = read(paths[0], buf, sizeof buf)) > 0)
+    list.append(buf, n);
+  close(paths[0]);
+
+  devices.clear();
+  size_t start = 0, end;
+  while ((end = list.find('\n', start)) != std::string::npos)
+  {
+    devices.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return pid;
+}
+
+// Run one configuration on an already populated hub
+static void measure(IcsBusHub &hub, IcsCommand::Type type, unsigned int value, Result &result)
+{
+  int joints = hub.getJointCount();
+  std::vector<unsigned int> values(joints, value);
+  std::vector<int> replies(joints);
+  IcsLatencyHistogram cycleHist;
+
+  for (int c = 0; c < warmup; c++)
+    hub.run(type, values.data(), replies.data());
+  for (int b = 0; b < hub.getBusCount(); b++)
+  {
+    IcsHardSerialClass *bus = dynamic_cast<IcsHardSerialClass *>(&hub.getBus(b));
+    if (bus)
+      bus->getLatency().reset();
+  }
+
+  result.failed = 0;
+  long long wallStart = IcsClock::nowNs();
+  long long cpuStart = cpuNs();
+  for (int c = 0; c < cycles; c++)
+  {
+    long long t0 = IcsClock::nowNs();
+    hub.run(type, values.data(), replies.data());
+    cycleHist.record(IcsClock::nowNs() - t0);
+    for (int j = 0; j < joints; j++)
+      if (replies[j] == IcsBaseClass::ICS_FALSE)
+        result.failed++;
+  }
+  long long wall = IcsClock::nowNs() - wallStart;
+  long long cpu = cpuNs() - cpuStart;
+
+  result.transactionsPerS = (double)cycles * joints * 1e9 / wall;
+  result.cycleHz = cycles * 1e9 / wall;
+  result.cpuPercent = 100.0 * cpu / wall;
+  cycleHist.snapshot(result.cycle);
+
+  memset(&result.transaction, 0, sizeof result.transaction);
+  for (int b = 0; b < hub.getBusCount(); b++)
+  {
+    IcsHardSerialClass *bus = dynamic_cast<IcsHardSerialClass *>(&hub.getBus(b));
+    if (!bus)
+      continue;
+    IcsLatencySnapshot snap;
+    bus->getLatency().snapshot(IcsBusLatency::SCOPE_BUS, IcsBusLatency::LAT_TOTAL, snap);
+    result.transaction.merge(snap);
+  }
+}
+
+// {"p50": .., "p99": .., "p999": .., "max": ..} in microseconds
+static void jsonPercentiles(FILE *f, const char *name, const IcsLatencySnapshot &s)
+{
+  fprintf(f, "\"%s\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f, \"mean\": %.1f}",
+          name, s.percentile(0.5) / 1e3, s.percentile(0.99) / 1e3, s.percentile(0.999) / 1e3, s.maxNs / 1e3, s.meanNs() / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *next = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!next)
+    {
+      printf("Missing value for %s\n", arg);
+      return 1;
+    }
+    i++;
+    if (!strcmp(arg, "--baud"))
+      bauds = parseInts(next);
+    else if (!strcmp(arg, "--buses"))
+      busCounts = parseInts(next);
+    else if (!strcmp(arg, "--servos"))
+      servoCounts = parseInts(next);
+    else if (!strcmp(arg, "--cmds"))
+      cmds = parseWords(next);
+    else if (!strcmp(arg, "--cycles"))
+      cycles = atoi(next);
+    else if (!strcmp(arg, "--turnaround"))
+      turnaroundUs = atoi(next);
+    else if (!strcmp(arg, "--json"))
+      jsonPath = next;
+    else if (!strcmp(arg, "--oe"))
+      oePin = atoi(next);
+    else if (!strcmp(arg, "--hw"))
+    {
+      HwBus bus;
+      if (!parseHw(next, bus))
+      {
+        printf("Bad --hw specification %s\n", next);
+        return 1;
+      }
+      hwBuses.push_back(bus);
+    }
+    else
+    {
+      printf("Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (cycles < 1)
+    cycles = 1;
+
+  if (!hwBuses.empty() && oePin >= 0)
+  {
+    // Bidirectional voltage shifter OE to HIGH, otherwise no reply reaches the UARTs
+    if (wiringPiSetupGpio() == -1)
+    {
+      printf("Error initialising wiringPi GPIO\n");
+      return 1;
+    }
+    pinMode(oePin, OUTPUT);
+    digitalWrite(oePin, HIGH);
+    delay(100);
+  }
+
+  FILE *json = fopen(jsonPath, "w");
+  if (!json)
+  {
+    printf("Failed to open %s\n", jsonPath);
+    return 1;
+  }
+  fprintf(json, "{\n  \"target\": \"%s\",\n  \"cycles\": %d,\n  \"turnaround_us\": %d,\n  \"results\": [",
+          hwBuses.empty() ? "sim" : "hw", cycles, turnaroundUs);
+
+  std::vector<std::string> lines;
+  bool first = true;
+
+  for (size_t bi = 0; bi < bauds.size(); bi++)
+    for (size_t ni = 0; ni < busCounts.size(); ni++)
+      for (size_t si = 0; si < servoCounts.size(); si++)
+        for (size_t ci = 0; ci < cmds.size(); ci++)
+        {
+          unsigned int baud = bauds[bi];
+          int buses = busCounts[ni];
+          int servos = servoCounts[si];
+          IcsCommand::Type type;
+          unsigned int value;
+
+          if (!commandType(cmds[ci], type, value))
+          {
+            printf("Unknown command %s (pos, read, write, id)\n", cmds[ci].c_str());
+            return 1;
+          }
+          if (!hwBuses.empty())
+          {
+            // Real buses have a fixed layout, only the bus count is swept
+            if (buses > (int)hwBuses.size() || si > 0)
+              continue;
+          }
+          else if (buses < 1 || buses > 5 || servos < 1 || servos > 32)
+          {
+            continue;
+          }
+          if (type == IcsCommand::GET_ID && (hwBuses.empty() ? servos : (int)hwBuses[0].ids.size()) != 1)
+            continue; // The ID command needs a single servo per bus
+
+          std::vector<std::string> devices;
+          int control = -1;
+          pid_t child = -1;
+          if (hwBuses.empty())
+          {
+            child = startSimulators(buses, servos, baud, devices, &control);
+            if (child < 0 || (int)devices.size() != buses)
+            {
+              printf("Failed to start the simulators\n");
+              return 1;
+            }
+          }
+
+          Result result;
+          {
+            IcsBusHub hub;
+            for (int b = 0; b < buses; b++)
+            {
+              if (hwBuses.empty())
+              {
+                int bus = hub.addBus(devices[b].c_str(), IcsHardSerialClass::ENABLE_PINS[b], baud, timeout);
+                for (int id = 0; id < servos; id++)
+                  hub.addJoint(bus, id);
+              }
+              else
+              {
+                int bus = hub.addBus(hwBuses[b].device.c_str(), hwBuses[b].enpin, baud, timeout);
+                for (size_t k = 0; k < hwBuses[b].ids.size(); k++)
+                  hub.addJoint(bus, hwBuses[b].ids[k]);
+              }
+            }
+            measure(hub, type, value, result);
+          }
+
+          if (child > 0)
+          {
+            close(control);
+            waitpid(child, NULL, 0);
+          }
+
+          char line[256];
+          snprintf(line, sizeof line, "%8u %5d %6d  %-5s %10.0f %9.1f %6.1f %9.1f %9.1f %9.1f %7lu",
+                   baud, buses, hwBuses.empty() ? servos : -1, cmds[ci].c_str(), result.transactionsPerS, result.cycleHz,
+                   result.cpuPercent, result.transaction.percentile(0.5) / 1e3, result.transaction.percentile(0.99) / 1e3,
+                   result.transaction.percentile(0.999) / 1e3, result.failed);
+          lines.push_back(line);
+          fprintf(stderr, "%s\n", line);
+
+          fprintf(json, "%s\n    {\"baud\": %u, \"buses\": %d, \"servos_per_bus\": %d, \"command\": \"%s\", "
+                        "\"transactions_per_s\": %.1f, \"cycle_hz\": %.2f, \"cpu_percent\": %.1f, \"failed\": %lu, ",
+                  first ? "" : ",", baud, buses, hwBuses.empty() ? servos : (int)hwBuses[0].ids.size(), cmds[ci].c_str(),
+                  result.transactionsPerS, result.cycleHz, result.cpuPercent, result.failed);
+          jsonPercentiles(json, "cycle_us", result.cycle);
+          fprintf(json, ", ");
+          jsonPercentiles(json, "transaction_us", result.transaction);
+          fprintf(json, "}");
+          first = false;
+        }
+
+  fprintf(json, "\n  ]\n}\n");
+  fclose(json);
+
+  // The library prints while opening ports, so the table comes at the end
+  printf("\n    baud buses servos  cmd        tx/s  cycle Hz   cpu%%   p50 us    p99 us  p99.9 us  failed\n");
+  for (size_t i = 0; i < lines.size(); i++)
+    printf("%s\n", lines[i].c_str());
+  printf("\nResults written to %s\n", jsonPath);
+  return 0;
+}
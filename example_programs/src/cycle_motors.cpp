@@ -0,0 +1,77 @@
+// all_motors.cpp as a fixed 200 Hz control loop: IcsCycleDriver + IcsBusHub
+// Prints the loop timing once per second
+// Usage: ./cycle_motors [topology]   (default ../robot.ini)
+// sudo chmod 666 /dev/ttyAMA1
+// sudo chmod 666 /dev/ttyAMA2
+// sudo chmod 666 /dev/ttyAMA3
+// sudo chmod 666 /dev/ttyAMA4
+
+#include <cstdio>
+#include <wiringPi.h>
+#include <IcsCycleDriver.h>
+#include <IcsTopology.h>
+
+// Robot description: serial ports, motor IDs, enable pins and timing
+const char *topologyFile = "../robot.ini";
+
+// Control rate
+const int rateHz = 200;
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    topologyFile = argv[1];
+  IcsTopology topology;
+  if (!topology.load(topologyFile))
+    return 1;
+
+  // uses BCM numbering of the GPIOs and directly accesses the GPIO registers.
+  if (wiringPiSetupGpio() == -1)
+  {
+    printf("Error initialising wiringPi GPIO\n");
+    return 1;
+  }
+
+  // One worker thread per port, level shifter enabled first
+  IcsBusHub hub;
+  if (!topology.build(hub))
+    return 1;
+
+  // Real-time settings: bus workers on cores 1-3, control loop on core 0, no page faults, no timer slack
+  // Needs root or CAP_SYS_NICE/CAP_IPC_LOCK; whatever could not be applied is reported
+  IcsRtPolicy rt;
+  rt.scheduler = IcsRtPolicy::RT_SCHED_FIFO;
+  rt.priority = 80;
+  rt.lockMemory = true;
+  rt.prefaultStackBytes = 256 * 1024;
+  rt.timerSlackNs = 1;
+  for (int b = 0; b < hub.getBusCount(); b++)
+  {
+    rt.cpus.assign(1, 1 + b % 3);
+    printf("bus %d RT: %s\n", b, hub.setRtPolicy(b, rt).summary().c_str());
+  }
+  rt.cpus.assign(1, 0);
+  rt.priority = 70;
+  printf("control loop RT: %s\n", rt.apply().summary().c_str());
+
+  IcsCycleDriver driver(hub, 1000000000LL / rateHz);
+  driver.setCallback([&](unsigned long cycle, const int *feedback, unsigned int *targets, int joints)
+  {
+    // Hold every joint at the centre position
+    for (int j = 0; j < joints; j++)
+      targets[j] = 7500;
+
+    if (cycle % rateHz == rateHz - 1)
+    {
+      const IcsCycleStats &s = driver.getStats();
+      printf("cycles %lu  misses %lu  jitter mean %.1f max %.1f us  exec mean %.1f max %.1f us  ID %d at %d\n",
+             s.cycles, s.misses, s.jitterSumNs / 1000.0 / s.cycles, s.jitterMaxNs / 1000.0,
+             s.execSumNs / 1000.0 / s.cycles, s.execMaxNs / 1000.0, hub.getJoint(0).id, feedback[0]);
+      driver.resetStats();
+    }
+  });
+
+  driver.run();
+
+  return 0;
+}
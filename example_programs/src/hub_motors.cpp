@@ -0,0 +1,68 @@
+// Same robot as all_motors.cpp, but the ports are driven in parallel through IcsBusHub
+// Usage: ./hub_motors [topology]
+// e.g.   ./hub_motors ../robot.ini   (joint angles of 0 rad through its calibration instead of raw position 7500)
+// sudo chmod 666 /dev/ttyAMA1
+// sudo chmod 666 /dev/ttyAMA2
+// sudo chmod 666 /dev/ttyAMA3
+// sudo chmod 666 /dev/ttyAMA4
+
+#include <cstdio>
+#include <vector>
+#include <wiringPi.h>
+#include <IcsBusHub.h>
+#include <IcsCalibration.h>
+#include <IcsTopology.h>
+
+// Robot description: serial ports, motor IDs, enable pins, timing and calibration
+const char *topologyFile = "../robot.ini";
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    topologyFile = argv[1];
+  IcsTopology topology;
+  if (!topology.load(topologyFile))
+    return 1;
+
+  // uses BCM numbering of the GPIOs and directly accesses the GPIO registers.
+  if (wiringPiSetupGpio() == -1)
+  {
+    printf("Error initialising wiringPi GPIO\n");
+    return 1;
+  }
+
+  // One worker thread per port, level shifter enabled first
+  IcsBusHub hub;
+  if (!topology.build(hub))
+    return 1;
+  printf("%d servo settings not acknowledged\n", topology.applyModels(hub));
+
+  std::vector<unsigned int> pos(hub.getJointCount(), 7500);
+  std::vector<int> reply(hub.getJointCount());
+
+  // Joint calibration, the robot holds every joint at 0 rad
+  IcsCalibration calibration;
+  std::vector<float> rad(hub.getJointCount(), 0.0f);
+  if (topology.buildCalibration(calibration))
+  {
+    int clamped = calibration.toPositions(rad.data(), pos.data());
+    printf("Calibration loaded, %d joints clamped to their limits at 0 rad\n", clamped);
+  }
+  else
+    printf("Calibration of %s not usable, holding raw position 7500\n", topologyFile);
+
+  // Main loop to control the servos
+  while (true)
+  {
+    unsigned int start = micros();
+    hub.setPositions(pos.data(), reply.data());
+    unsigned int cycle = micros() - start;
+
+    for (int j = 0; j < hub.getJointCount(); j++)
+      printf("ID: %d, reply: %d\n", hub.getJoint(j).id, reply[j]);
+    printf("One cycle complete in %u us\n", cycle);
+    delay(10);
+  }
+
+  return 0;
+}
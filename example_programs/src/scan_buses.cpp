@@ -0,0 +1,90 @@
+// Find the servos on every bus of a robot at boot, all buses probed at once through IcsBusScan
+// Prints the IDs found in robot.ini form and compares them with the joints of the topology file
+// Usage: ./scan_buses [topology] [probe_timeout_us]
+// e.g.   ./scan_buses ../robot.ini 1000
+// sudo chmod 666 /dev/ttyAMA1
+// sudo chmod 666 /dev/ttyAMA2
+// sudo chmod 666 /dev/ttyAMA3
+// sudo chmod 666 /dev/ttyAMA4
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <wiringPi.h>
+#include <IcsBusHub.h>
+#include <IcsBusScan.h>
+#include <IcsTopology.h>
+
+// Robot description: serial ports, enable pins, baud rate and the expected IDs
+const char *topologyFile = "../robot.ini";
+// Wait for each ID to answer (us)
+unsigned int probeTimeoutUs = 1000;
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    topologyFile = argv[1];
+  if (argc > 2)
+    probeTimeoutUs = atoi(argv[2]);
+
+  IcsTopology topology;
+  if (!topology.load(topologyFile))
+    return 1;
+
+  // uses BCM numbering of the GPIOs and directly accesses the GPIO registers.
+  if (wiringPiSetupGpio() == -1)
+  {
+    printf("Error initialising wiringPi GPIO\n");
+    return 1;
+  }
+
+  IcsBusHub hub;
+  if (!topology.build(hub))
+    return 1;
+
+  IcsBusScan scanner;
+  scanner.setProbeTimeout(probeTimeoutUs);
+  IcsScanResult result;
+  bool unique = scanner.scan(hub, result);
+
+  printf("%d servos on %d buses in %.1f ms\n", result.getServoCount(), hub.getBusCount(), result.elapsedNs / 1e6);
+  for (int b = 0; b < hub.getBusCount(); b++)
+  {
+    const IcsScanBus &bus = result.buses[b];
+    printf("\n[bus.%s]            ; %.1f ms\n", topology.getBus(b).name.c_str(), bus.elapsedNs / 1e6);
+    printf("device = %s\n", topology.getBus(b).device.c_str());
+    printf("ids = ");
+    for (size_t i = 0; i < bus.ids.size(); i++)
+      printf(i ? ", %d" : "%d", bus.ids[i]);
+    printf("\n");
+    for (int id = 0; id < IcsBusScan::ID_COUNT; id++)
+    {
+      if ((bus.duplicates >> id) & 1)
+        printf("; ID %d answered by more than one servo\n", id);
+      if ((bus.partial >> id) & 1)
+        printf("; ID %d sent an incomplete reply\n", id);
+    }
+  }
+
+  // Joints of the topology that did not answer, and servos the topology does not know
+  int missing = 0;
+  std::vector<unsigned int> expected(hub.getBusCount(), 0);
+  for (int j = 0; j < topology.getJointCount(); j++)
+  {
+    const IcsTopologyJoint &joint = topology.getJoint(j);
+    expected[joint.bus] |= 1u << joint.id;
+    if (!((result.buses[joint.bus].present >> joint.id) & 1))
+    {
+      printf("\nmissing: joint %s (bus %s ID %d)", joint.name.c_str(), topology.getBus(joint.bus).name.c_str(), joint.id);
+      missing++;
+    }
+  }
+  for (int b = 0; b < hub.getBusCount(); b++)
+    for (int id = 0; id < IcsBusScan::ID_COUNT; id++)
+      if (((result.buses[b].present & ~expected[b]) >> id) & 1)
+        printf("\nunexpected: bus %s ID %d", topology.getBus(b).name.c_str(), id);
+  printf("\n%d of %d joints missing, %s\n", missing, topology.getJointCount(),
+         unique ? "no shared IDs" : "shared IDs found");
+
+  return (missing == 0 && unique) ? 0 : 1;
+}
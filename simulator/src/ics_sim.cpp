@@ -0,0 +1,125 @@
+// Emulate a chain of ICS servos on a pseudo-terminal, for running the examples and benchmarks without hardware
+// Usage: ./ics_sim [servos] [baudrate] [turnaround_us] [link] [options]
+// e.g.   ./ics_sim 6 1250000 100 /tmp/ttyICS0
+//        then ./bench_rx_mode /tmp/ttyICS0 7 1250000 1 5000
+// options is a comma separated list of key=value:
+//        faults: seed, loss, parity, flip, late, late_us, dup, silent (probabilities 0-1), silent_mask (servo ID bits)
+//        dynamics: model (0 none, 1 first order, 2 second order), scale (model seconds per second)
+// e.g.   ./ics_sim 6 1250000 100 /tmp/ttyICS0 seed=7,loss=0.001,late=0.01,late_us=20000
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <IcsServoSim.h>
+
+// Default chain (IDs 0 to 5, like one port of the HDS PCB)
+int servos = 6;
+unsigned int baudRate = 1250000;
+int turnaroundUs = 100;
+const char *linkPath = NULL;
+IcsSimFaults faults;
+IcsServoModel model;
+double timeScale = 1.0;
+
+volatile sig_atomic_t quit = 0;
+
+static void onSignal(int)
+{
+  quit = 1;
+}
+
+// Read "key=value,key=value" into the fault and model settings
+static bool parseOptions(char *spec)
+{
+  for (char *item = strtok(spec, ","); item; item = strtok(NULL, ","))
+  {
+    char *value = strchr(item, '=');
+    if (!value)
+      return false;
+    *value++ = 0;
+
+    if (!strcmp(item, "seed"))
+      faults.seed = strtoul(value, NULL, 0);
+    else if (!strcmp(item, "loss"))
+      faults.byteLoss = atof(value);
+    else if (!strcmp(item, "parity"))
+      faults.parityError = atof(value);
+    else if (!strcmp(item, "flip"))
+      faults.bitFlip = atof(value);
+    else if (!strcmp(item, "late"))
+      faults.lateReply = atof(value);
+    else if (!strcmp(item, "late_us"))
+      faults.lateDelayNs = atoll(value) * 1000LL;
+    else if (!strcmp(item, "dup"))
+      faults.duplicateReply = atof(value);
+    else if (!strcmp(item, "silent"))
+      faults.silent = atof(value);
+    else if (!strcmp(item, "silent_mask"))
+      faults.silentMask = strtoul(value, NULL, 0);
+    else if (!strcmp(item, "model"))
+      model.order = (IcsServoModel::Order)atoi(value);
+    else if (!strcmp(item, "scale"))
+      timeScale = atof(value);
+    else
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    servos = atoi(argv[1]);
+  if (argc > 2)
+    baudRate = atoi(argv[2]);
+  if (argc > 3)
+    turnaroundUs = atoi(argv[3]);
+  if (argc > 4)
+    linkPath = argv[4];
+  if (argc > 5 && !parseOptions(argv[5]))
+  {
+    printf("Unknown option\n");
+    return 1;
+  }
+
+  IcsServoSim sim(baudRate);
+  sim.setTurnaround(turnaroundUs * 1000LL);
+  sim.addServos(servos);
+  sim.setFaults(faults);
+  sim.setModel(model);
+  sim.setTimeScale(timeScale);
+  if (!sim.start())
+    return 1;
+
+  // A fixed name is easier to pass around than /dev/pts/N
+  if (linkPath)
+  {
+    unlink(linkPath);
+    if (symlink(sim.getDevice(), linkPath) != 0)
+    {
+      printf("Failed to create the link %s\n", linkPath);
+      linkPath = NULL;
+    }
+  }
+
+  printf("%d servos at %u baud, turnaround %d us on %s\n", servos, baudRate, turnaroundUs, linkPath ? linkPath : sim.getDevice());
+  printf("Ctrl-C to stop\n");
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  while (!quit)
+    pause();
+
+  sim.stop();
+  if (linkPath)
+    unlink(linkPath);
+
+  IcsSimStats stats = sim.getStats();
+  printf("\nframes %lu  replies %lu  unanswered %lu  garbage bytes %lu  broken frames %lu\n",
+         stats.frames, stats.replies, stats.unanswered, stats.garbageBytes, stats.brokenFrames);
+  printf("injected: lost %lu  parity %lu  flipped %lu  late %lu  duplicate %lu  silent %lu\n",
+         stats.lostBytes, stats.parityErrors, stats.flippedBytes, stats.lateReplies, stats.duplicates, stats.silences);
+  return 0;
+}